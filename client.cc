@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -28,18 +29,53 @@
 #include "include/grpcpp/support/status.h"
 #include "client_lib.h"
 #include "data_util.h"
+#include "key_pool.h"
 #include "match.grpc.pb.h"
 #include "match.pb.h"
+#include "unbalanced_client_lib.h"
 #include "absl/memory/memory.h"
 
 DEFINE_string(port, "0.0.0.0:10501", "Port on which to contact server");
 DEFINE_string(client_data_file, "",
-              "The file from which to read the client database.");
+              "The file from which to read the client database. Each line "
+              "holds an identifier followed by one or more associated values; "
+              "one intersection-sum is computed per associated value column.");
 DEFINE_int32(
     paillier_modulus_size, 1536,
     "The bit-length of the modulus to use for Paillier encryption. The modulus "
-    "will be the product of two safe primes, each of size "
+    "will be the product of two primes, each of size "
     "paillier_modulus_size/2.");
+DEFINE_bool(paillier_safe_primes, true,
+            "Whether the Paillier modulus is the product of two safe primes. "
+            "Ordinary primes make key generation orders of magnitude faster.");
+DEFINE_string(paillier_key_pool_dir, "",
+              "If set, take a pre-generated Paillier key matching "
+              "paillier_modulus_size and paillier_safe_primes from this "
+              "directory (see paillier_key_pool) instead of generating one. "
+              "Falls back to generating a key if the pool has none.");
+DEFINE_double(fingerprint_false_positive_rate, 0,
+              "If positive, send the server fingerprints of its re-encrypted "
+              "set instead of the points, as short as this expected number of "
+              "false matches allows. 0 sends the full points.");
+DEFINE_bool(compress_reencrypted_set, false,
+            "Whether to send the re-encrypted set of the server prefix-delta "
+            "compressed. Needs a server that supports it.");
+DEFINE_double(sampling_rate, 1,
+              "If less than 1, run the approximate mode: both parties only "
+              "take part with a random sample of this rate of their sets, and "
+              "the client estimates the intersection size with a 95% "
+              "confidence interval. The sums are over the sampled "
+              "intersection, and the server learns the size of the client's "
+              "sample.");
+DEFINE_bool(unbalanced, false,
+            "Whether to run the unbalanced mode, for small client sets against "
+            "very large server sets: the client tests its own set against a "
+            "filter of the server's set, and learns which of its identifiers "
+            "are in the intersection.");
+DEFINE_string(server_filter_file, "",
+              "If set, the file keeping the server's filter between runs of "
+              "the unbalanced mode. The filter is fetched from the server and "
+              "written to it if it does not exist.");
 
 using ::private_join_and_compute::PrivateJoinAndComputeRpc;
 
@@ -48,7 +84,8 @@ int ExecuteProtocol() {
 
   std::cout << "Client: Loading data..." << std::endl;
   auto maybe_client_identifiers_and_associated_values =
-      ::private_join_and_compute::ReadClientDatasetFromFile(FLAGS_client_data_file, &context);
+      ::private_join_and_compute::ReadClientDatasetWithValueColumnsFromFile(
+          FLAGS_client_data_file);
   if (!maybe_client_identifiers_and_associated_values.ok()) {
     std::cerr << "Client::ExecuteProtocol: failed "
               << maybe_client_identifiers_and_associated_values.status()
@@ -58,12 +95,40 @@ int ExecuteProtocol() {
   auto client_identifiers_and_associated_values =
       std::move(maybe_client_identifiers_and_associated_values.ValueOrDie());
 
-  std::cout << "Client: Generating keys..." << std::endl;
-  std::unique_ptr<::private_join_and_compute::Client> client =
-      absl::make_unique<::private_join_and_compute::Client>(
+  ::private_join_and_compute::PaillierPrimeType prime_type =
+      FLAGS_paillier_safe_primes
+          ? ::private_join_and_compute::PaillierPrimeType::kSafePrimes
+          : ::private_join_and_compute::PaillierPrimeType::kPrimes;
+  std::unique_ptr<::private_join_and_compute::Client> client;
+  if (!FLAGS_paillier_key_pool_dir.empty()) {
+    auto maybe_paillier_key = ::private_join_and_compute::TakeKeyFromPool(
+        FLAGS_paillier_key_pool_dir, FLAGS_paillier_modulus_size, prime_type);
+    if (maybe_paillier_key.ok()) {
+      std::cout << "Client: Using a pre-generated key from "
+                << FLAGS_paillier_key_pool_dir << "..." << std::endl;
+      client = absl::make_unique<::private_join_and_compute::Client>(
           &context, std::move(client_identifiers_and_associated_values.first),
           std::move(client_identifiers_and_associated_values.second),
-          FLAGS_paillier_modulus_size);
+          maybe_paillier_key.ValueOrDie());
+    } else if (!::util::IsNotFound(maybe_paillier_key.status())) {
+      std::cerr << "Client::ExecuteProtocol: failed to TakeKeyFromPool: "
+                << maybe_paillier_key.status() << std::endl;
+      return 1;
+    } else {
+      std::cout << "Client: The key pool is empty." << std::endl;
+    }
+  }
+  if (client == nullptr) {
+    std::cout << "Client: Generating keys..." << std::endl;
+    client = absl::make_unique<::private_join_and_compute::Client>(
+        &context, std::move(client_identifiers_and_associated_values.first),
+        std::move(client_identifiers_and_associated_values.second),
+        FLAGS_paillier_modulus_size, prime_type);
+  }
+  client->SetFingerprintFalsePositiveRate(
+      FLAGS_fingerprint_false_positive_rate);
+  client->SetCompressReencryptedSet(FLAGS_compress_reencrypted_set);
+  client->SetSamplingRate(FLAGS_sampling_rate);
 
   // Consider grpc::SslServerCredentials if not running locally.
   std::unique_ptr<PrivateJoinAndComputeRpc::Stub> stub =
@@ -77,6 +142,9 @@ int ExecuteProtocol() {
       << "Client: Waiting for response and encrypted set from the server..."
       << std::endl;
   ::private_join_and_compute::StartProtocolRequest start_protocol_request;
+  start_protocol_request.set_sampling_rate(FLAGS_sampling_rate);
+  start_protocol_request.set_sampling_salt_share(
+      client->sampling_salt_share());
   ::private_join_and_compute::ServerRoundOne server_round_one;
   ::grpc::ClientContext start_protocol_client_context;
   ::grpc::Status status =
@@ -119,29 +187,196 @@ int ExecuteProtocol() {
   std::cout << "Client: Received response from the server. Decrypting the "
                "intersection-sum."
             << std::endl;
-  auto maybe_intersection_size_and_sum = client->DecryptSum(server_round_two);
-  if (!maybe_intersection_size_and_sum.ok()) {
-    std::cerr << "Client::ExecuteProtocol: failed to DecryptSum: "
-              << maybe_intersection_size_and_sum.status() << std::endl;
+  auto maybe_intersection_size_and_sums =
+      client->DecryptSums(server_round_two);
+  if (!maybe_intersection_size_and_sums.ok()) {
+    std::cerr << "Client::ExecuteProtocol: failed to DecryptSums: "
+              << maybe_intersection_size_and_sums.status() << std::endl;
     return 1;
   }
-  auto intersection_size_and_sum =
-      std::move(maybe_intersection_size_and_sum.ValueOrDie());
+  auto intersection_size_and_sums =
+      std::move(maybe_intersection_size_and_sums.ValueOrDie());
 
   // Output the result.
 
-  int64_t intersection_size = intersection_size_and_sum.first;
-  auto maybe_intersection_sum = intersection_size_and_sum.second.ToIntValue();
-  if (!maybe_intersection_sum.ok()) {
-    std::cerr
-        << "Client::ExecuteProtocol: failed to recover the intersection sum: "
-        << maybe_intersection_sum.status() << std::endl;
+  int64_t intersection_size = intersection_size_and_sums.first;
+  std::vector<uint64_t> intersection_sums;
+  for (const auto& sum : intersection_size_and_sums.second) {
+    auto maybe_intersection_sum = sum.ToIntValue();
+    if (!maybe_intersection_sum.ok()) {
+      std::cerr
+          << "Client::ExecuteProtocol: failed to recover the intersection sum: "
+          << maybe_intersection_sum.status() << std::endl;
+      return 1;
+    }
+    intersection_sums.push_back(maybe_intersection_sum.ValueOrDie());
+  }
+
+  std::cout << "Client: The intersection size is " << intersection_size;
+  if (intersection_sums.size() == 1) {
+    std::cout << " and the intersection-sum is " << intersection_sums[0];
+  } else {
+    std::cout << " and the intersection-sums are";
+    for (size_t k = 0; k < intersection_sums.size(); k++) {
+      std::cout << (k == 0 ? " " : ", ") << intersection_sums[k];
+    }
+  }
+  std::cout << std::endl;
+
+  if (FLAGS_sampling_rate < 1) {
+    auto maybe_estimate = client->EstimateIntersectionSize(server_round_two);
+    if (!maybe_estimate.ok()) {
+      std::cerr << "Client::ExecuteProtocol: failed to "
+                   "EstimateIntersectionSize: "
+                << maybe_estimate.status() << std::endl;
+      return 1;
+    }
+    const auto& estimate = maybe_estimate.ValueOrDie();
+    std::cout << "Client: The above is over a sample of rate "
+              << FLAGS_sampling_rate
+              << ". The estimated size of the whole intersection is "
+              << estimate.size << ", within [" << estimate.lower_bound << ", "
+              << estimate.upper_bound << "] with 95% confidence."
+              << std::endl;
+  }
+
+  return 0;
+}
+
+// Reads the server's filter from --server_filter_file, or fetches it from the
+// server and writes it there if the file does not exist.
+bool LoadOrFetchServerFilter(
+    PrivateJoinAndComputeRpc::Stub* stub,
+    ::private_join_and_compute::ServerFilter* filter) {
+  if (!FLAGS_server_filter_file.empty()) {
+    std::ifstream filter_in(FLAGS_server_filter_file, std::ios::binary);
+    if (filter_in.is_open()) {
+      std::cout << "Client: Using the server's filter kept in "
+                << FLAGS_server_filter_file << "..." << std::endl;
+      if (!filter->ParseFromIstream(&filter_in)) {
+        std::cerr << "Client::ExecuteUnbalancedProtocol: failed to parse "
+                  << FLAGS_server_filter_file << std::endl;
+        return false;
+      }
+      return true;
+    }
+  }
+
+  std::cout << "Client: Fetching the server's filter..." << std::endl;
+  ::private_join_and_compute::GetFilterRequest get_filter_request;
+  ::grpc::ClientContext get_filter_client_context;
+  ::grpc::Status status =
+      stub->GetFilter(&get_filter_client_context, get_filter_request, filter);
+  if (!status.ok()) {
+    std::cerr << "Client::ExecuteUnbalancedProtocol: failed to GetFilter: "
+              << status.error_message() << std::endl;
+    return false;
+  }
+  if (!FLAGS_server_filter_file.empty()) {
+    std::ofstream filter_out(FLAGS_server_filter_file, std::ios::binary);
+    if (!filter->SerializeToOstream(&filter_out)) {
+      std::cerr << "Client::ExecuteUnbalancedProtocol: failed to write "
+                << FLAGS_server_filter_file << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int ExecuteUnbalancedProtocol() {
+  ::private_join_and_compute::Context context;
+
+  std::cout << "Client: Loading data..." << std::endl;
+  auto maybe_client_identifiers_and_associated_values =
+      ::private_join_and_compute::ReadClientDatasetWithValueColumnsFromFile(
+          FLAGS_client_data_file);
+  if (!maybe_client_identifiers_and_associated_values.ok()) {
+    std::cerr << "Client::ExecuteUnbalancedProtocol: failed "
+              << maybe_client_identifiers_and_associated_values.status()
+              << std::endl;
+    return 1;
+  }
+  auto client_identifiers_and_associated_values =
+      std::move(maybe_client_identifiers_and_associated_values.ValueOrDie());
+  ::private_join_and_compute::UnbalancedClient client(
+      &context, std::move(client_identifiers_and_associated_values.first),
+      std::move(client_identifiers_and_associated_values.second));
+
+  // Consider grpc::SslServerCredentials if not running locally.
+  std::unique_ptr<PrivateJoinAndComputeRpc::Stub> stub =
+      PrivateJoinAndComputeRpc::NewStub(::grpc::CreateChannel(
+          FLAGS_port, ::grpc::experimental::LocalCredentials(
+                          grpc_local_connect_type::LOCAL_TCP)));
+
+  ::private_join_and_compute::ServerFilter filter;
+  if (!LoadOrFetchServerFilter(stub.get(), &filter)) {
+    return 1;
+  }
+
+  std::cout << "Client: Encrypting the client data..." << std::endl;
+  auto maybe_client_round_one = client.EncryptSet();
+  if (!maybe_client_round_one.ok()) {
+    std::cerr << "Client::ExecuteUnbalancedProtocol: failed to EncryptSet: "
+              << maybe_client_round_one.status() << std::endl;
+    return 1;
+  }
+
+  std::cout << "Client: Sending the encrypted client data to the server."
+            << std::endl
+            << "Client: Waiting for its re-encryption..." << std::endl;
+  ::private_join_and_compute::UnbalancedServerRoundOne server_round_one;
+  ::grpc::ClientContext unbalanced_round_client_context;
+  ::grpc::Status status = stub->ExecuteUnbalancedRound(
+      &unbalanced_round_client_context, maybe_client_round_one.ValueOrDie(),
+      &server_round_one);
+  if (!status.ok()) {
+    std::cerr << "Client::ExecuteUnbalancedProtocol: failed to "
+                 "ExecuteUnbalancedRound: "
+              << status.error_message() << std::endl;
     return 1;
   }
 
-  std::cout << "Client: The intersection size is " << intersection_size
-            << " and the intersection-sum is "
-            << maybe_intersection_sum.ValueOrDie() << std::endl;
+  std::cout << "Client: Received response from the server. Testing it "
+               "against the filter."
+            << std::endl;
+  auto maybe_intersection_size_and_sums =
+      client.ComputeIntersectionSums(filter, server_round_one);
+  if (!maybe_intersection_size_and_sums.ok()) {
+    std::cerr << "Client::ExecuteUnbalancedProtocol: failed to "
+                 "ComputeIntersectionSums: "
+              << maybe_intersection_size_and_sums.status() << std::endl;
+    if (!FLAGS_server_filter_file.empty()) {
+      std::cerr << "Delete " << FLAGS_server_filter_file
+                << " if the server's filter key changed." << std::endl;
+    }
+    return 1;
+  }
+  auto intersection_size_and_sums =
+      std::move(maybe_intersection_size_and_sums.ValueOrDie());
+
+  int64_t intersection_size = intersection_size_and_sums.first;
+  std::vector<uint64_t> intersection_sums;
+  for (const auto& sum : intersection_size_and_sums.second) {
+    auto maybe_intersection_sum = sum.ToIntValue();
+    if (!maybe_intersection_sum.ok()) {
+      std::cerr << "Client::ExecuteUnbalancedProtocol: failed to recover the "
+                   "intersection sum: "
+                << maybe_intersection_sum.status() << std::endl;
+      return 1;
+    }
+    intersection_sums.push_back(maybe_intersection_sum.ValueOrDie());
+  }
+
+  std::cout << "Client: The intersection size is " << intersection_size;
+  if (intersection_sums.size() == 1) {
+    std::cout << " and the intersection-sum is " << intersection_sums[0];
+  } else {
+    std::cout << " and the intersection-sums are";
+    for (size_t k = 0; k < intersection_sums.size(); k++) {
+      std::cout << (k == 0 ? " " : ", ") << intersection_sums[k];
+    }
+  }
+  std::cout << std::endl;
 
   return 0;
 }
@@ -150,5 +385,5 @@ int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
-  return ExecuteProtocol();
+  return FLAGS_unbalanced ? ExecuteUnbalancedProtocol() : ExecuteProtocol();
 }
@@ -17,31 +17,168 @@
 
 #include <algorithm>
 #include <iterator>
+#include <limits>
 
+#include "fingerprint.h"
+#include "key_pool.h"
+#include "set_sampling.h"
+#include "sorted_set_codec.h"
 #include "absl/memory/memory.h"
 
 namespace private_join_and_compute {
 
 using ::util::StatusOr;
 
+namespace {
+
+// The s used for states and messages that do not specify one.
+const int kDefaultPaillierS = 2;
+
+// Returns the number of bits needed to hold the sum of any subset of values,
+// i.e. the bit length of max(values) * values.size().
+int GetColumnBitWidth(Context* ctx, const std::vector<int64_t>& values) {
+  int64_t max_value = 0;
+  for (int64_t value : values) {
+    max_value = std::max(max_value, value);
+  }
+  return (ctx->CreateBigNum(max_value) * ctx->CreateBigNum(values.size()))
+      .BitLength();
+}
+
+std::vector<int> GetColumnBitWidths(
+    Context* ctx, const std::vector<std::vector<int64_t>>& value_columns) {
+  std::vector<int> widths;
+  for (const std::vector<int64_t>& column : value_columns) {
+    widths.push_back(GetColumnBitWidth(ctx, column));
+  }
+  return widths;
+}
+
+// Converts the BigNum value columns to int64 columns. Fails if a value is
+// negative or does not fit in an int64.
+std::vector<std::vector<int64_t>> ToIntColumns(
+    const std::vector<std::vector<BigNum>>& value_columns) {
+  std::vector<std::vector<int64_t>> int_columns;
+  int_columns.reserve(value_columns.size());
+  for (const std::vector<BigNum>& column : value_columns) {
+    std::vector<int64_t> int_column;
+    int_column.reserve(column.size());
+    for (const BigNum& value : column) {
+      CHECK(value.IsNonNegative()) << "Values must be nonnegative.";
+      StatusOr<uint64_t> int_value = value.ToIntValue();
+      CHECK(int_value.ok() &&
+            int_value.ValueOrDie() <= std::numeric_limits<int64_t>::max())
+          << "Values must fit in an int64.";
+      int_column.push_back(static_cast<int64_t>(int_value.ValueOrDie()));
+    }
+    int_columns.push_back(std::move(int_column));
+  }
+  return int_columns;
+}
+
+// Returns the smallest s >= 1 such that n^s is larger than any value that
+// fits in the packed column slots, which bounds any intersection sum. The
+// result may exceed kMaxPaillierS, which ReEncryptSet reports.
+int ChoosePaillierS(Context* ctx, const BigNum& n,
+                    const std::vector<int>& column_bit_widths) {
+  int total_bits = 0;
+  for (int width : column_bit_widths) {
+    total_bits += width;
+  }
+  BigNum bound = ctx->One().Lshift(total_bits);
+  int s = 1;
+  for (BigNum n_to_s = n; n_to_s < bound && s <= kMaxPaillierS;
+       n_to_s = n_to_s * n) {
+    s++;
+  }
+  return s;
+}
+
+}  // namespace
+
 Client::Client(Context* ctx, const std::vector<std::string>& elements,
-               const std::vector<BigNum>& values, int32_t modulus_size)
+               const std::vector<BigNum>& values, int32_t modulus_size,
+               PaillierPrimeType prime_type)
+    : Client(ctx, elements, std::vector<std::vector<BigNum>>(1, values),
+             modulus_size, prime_type) {}
+
+Client::Client(Context* ctx, const std::vector<std::string>& elements,
+               const std::vector<std::vector<BigNum>>& value_columns,
+               int32_t modulus_size, PaillierPrimeType prime_type)
+    : Client(ctx, elements, ToIntColumns(value_columns), modulus_size,
+             prime_type) {}
+
+Client::Client(Context* ctx, const std::vector<std::string>& elements,
+               std::vector<std::vector<int64_t>> value_columns,
+               int32_t modulus_size, PaillierPrimeType prime_type)
+    : Client(ctx, elements, std::move(value_columns),
+             GeneratePaillierKey(ctx, modulus_size, prime_type)) {}
+
+Client::Client(Context* ctx, const std::vector<std::string>& elements,
+               const std::vector<std::vector<BigNum>>& value_columns,
+               const PaillierKey& paillier_key)
+    : Client(ctx, elements, ToIntColumns(value_columns), paillier_key) {}
+
+Client::Client(Context* ctx, const std::vector<std::string>& elements,
+               std::vector<std::vector<int64_t>> value_columns,
+               const PaillierKey& paillier_key)
     : ctx_(ctx),
       elements_(elements),
-      values_(values),
-      p_(ctx_->GenerateSafePrime(modulus_size / 2)),
-      q_(ctx_->GenerateSafePrime(modulus_size / 2)),
+      value_columns_(std::move(value_columns)),
+      column_bit_widths_(GetColumnBitWidths(ctx_, value_columns_)),
+      prime_type_(paillier_key.safe_primes() ? PaillierPrimeType::kSafePrimes
+                                             : PaillierPrimeType::kPrimes),
+      p_(ctx_->CreateBigNum(paillier_key.p())),
+      q_(ctx_->CreateBigNum(paillier_key.q())),
+      s_(ChoosePaillierS(ctx_, p_ * q_, column_bit_widths_)),
       ec_cipher_(std::move(
-          ECCommutativeCipher::CreateWithNewKey(NID_secp224r1).ValueOrDie())) {}
+          ECCommutativeCipher::CreateWithNewKey(NID_secp224r1).ValueOrDie())) {
+  CheckValueColumns();
+}
+
+void Client::SetSamplingRate(double sampling_rate) {
+  CHECK(sampling_rate > 0 && sampling_rate <= 1)
+      << "The sampling rate must be in (0, 1].";
+  sampling_rate_ = sampling_rate;
+  sampling_salt_share_ =
+      sampling_rate < 1 ? ctx_->GenerateRandomBytes(kSamplingSaltBytes) : "";
+}
+
+void Client::CheckValueColumns() const {
+  for (const std::vector<int64_t>& column : value_columns_) {
+    CHECK_EQ(column.size(), elements_.size())
+        << "Each column must have one value per element.";
+    for (int64_t value : column) {
+      CHECK_GE(value, 0) << "Values must be nonnegative.";
+    }
+  }
+}
 
 Client::Client(Context* ctx, const std::string& serialized)
-    : ctx_(ctx), p_(ctx_->CreateBigNum(0)), q_(ctx_->CreateBigNum(0)) {
+    : ctx_(ctx),
+      prime_type_(PaillierPrimeType::kSafePrimes),
+      p_(ctx_->CreateBigNum(0)),
+      q_(ctx_->CreateBigNum(0)),
+      s_(kDefaultPaillierS) {
   ClientState state;
   assert(state.ParseFromString(serialized));
+  if (state.has_paillier_s()) {
+    s_ = state.paillier_s();
+  }
+  if (!state.safe_primes()) {
+    prime_type_ = PaillierPrimeType::kPrimes;
+  }
+  column_bit_widths_.assign(state.column_bit_widths().begin(),
+                            state.column_bit_widths().end());
+  fingerprint_false_positive_rate_ = state.fingerprint_false_positive_rate();
+  compress_reencrypted_set_ = state.compress_reencrypted_set();
+  sampling_rate_ = state.sampling_rate();
+  sampling_salt_share_ = state.sampling_salt_share();
   if (state.has_p() && state.has_q()) {
     p_ = ctx_->CreateBigNum(state.p());
     q_ = ctx_->CreateBigNum(state.q());
-    private_paillier_ = absl::make_unique<PrivatePaillier>(ctx_, p_, q_, 2);
+    private_paillier_ =
+        absl::make_unique<PrivatePaillier>(ctx_, p_, q_, s_, prime_type_);
   }
   ec_cipher_ = std::move(
       ECCommutativeCipher::CreateFromKey(NID_secp224r1, state.ec_key())
@@ -49,64 +186,211 @@ Client::Client(Context* ctx, const std::string& serialized)
 }
 
 StatusOr<ClientRoundOne> Client::ReEncryptSet(const ServerRoundOne& message) {
-  private_paillier_ = absl::make_unique<PrivatePaillier>(ctx_, p_, q_, 2);
+  // Recycles the BIGNUMs of the batch encryption and of hashing each element
+  // to the curve.
+  BigNumArena arena;
+  if (s_ > kMaxPaillierS) {
+    return util::InvalidArgumentError(
+        "ReEncryptSet: Too many or too wide value columns for the Paillier "
+        "modulus.");
+  }
+  private_paillier_ =
+      absl::make_unique<PrivatePaillier>(ctx_, p_, q_, s_, prime_type_);
   BigNum pk = p_ * q_;
   ClientRoundOne result;
   *result.mutable_public_key() = pk.ToBytes();
+  result.set_paillier_s(s_);
+  // In the approximate mode, only the elements in the sample take part in the
+  // protocol. The server must not pick another rate than the requested one,
+  // since the client's sample would then reveal more of its set.
+  if (message.sampling_rate() != sampling_rate_) {
+    return util::InvalidArgumentError(
+        "ReEncryptSet: The server's sampling rate is not the requested one.");
+  }
+  std::string sampling_salt;
+  if (sampling_rate_ < 1) {
+    if (message.sampling_salt_share().size() != kSamplingSaltBytes) {
+      return util::InvalidArgumentError(
+          "ReEncryptSet: The server's sampling salt share has the wrong size.");
+    }
+    sampling_salt = DeriveSamplingSalt(ctx_, message.sampling_salt_share(),
+                                       sampling_salt_share_);
+  }
+  std::vector<size_t> sampled_indices;
+  sampled_indices.reserve(elements_.size());
   for (size_t i = 0; i < elements_.size(); i++) {
+    if (InSample(ctx_, sampling_salt, elements_[i], sampling_rate_)) {
+      sampled_indices.push_back(i);
+    }
+  }
+  StatusOr<std::vector<BigNum>> values = EncryptValues(sampled_indices);
+  if (!values.ok()) {
+    return values.status();
+  }
+  // Every ciphertext is written with the byte length of n^(s+1), straight into
+  // the message.
+  const int ciphertext_width =
+      (pk.Exp(ctx_->CreateBigNum(s_ + 1)).BitLength() + 7) / 8;
+  for (size_t j = 0; j < sampled_indices.size(); j++) {
     EncryptedElement* element = result.mutable_encrypted_set()->add_elements();
-    StatusOr<std::string> encrypted = ec_cipher_->Encrypt(elements_[i]);
+    StatusOr<std::string> encrypted =
+        ec_cipher_->Encrypt(elements_[sampled_indices[j]]);
     if (!encrypted.ok()) {
       return encrypted.status();
     }
-    *element->mutable_element() = encrypted.ValueOrDie();
-    StatusOr<BigNum> value = private_paillier_->Encrypt(values_[i]);
-    if (!value.ok()) {
-      return value.status();
-    }
-    *element->mutable_associated_data() = value.ValueOrDie().ToBytes();
+    *element->mutable_element() = std::move(encrypted.ValueOrDie());
+    std::string* associated_data = element->mutable_associated_data();
+    associated_data->resize(ciphertext_width);
+    values.ValueOrDie()[j].ToBytesFixed(ciphertext_width,
+                                        &(*associated_data)[0]);
   }
 
-  std::vector<EncryptedElement> reencrypted_set;
+  // Sorting hides which of the server's elements each re-encryption comes
+  // from, and lets the server merge with it without sorting it again.
+  int fingerprint_bytes = 0;
+  if (fingerprint_false_positive_rate_ > 0) {
+    fingerprint_bytes = FingerprintBytes(
+        sampled_indices.size(), message.encrypted_set().elements_size(),
+        fingerprint_false_positive_rate_);
+    result.set_fingerprint_bytes(fingerprint_bytes);
+  }
+  std::vector<std::string> reencrypted_set;
+  reencrypted_set.reserve(message.encrypted_set().elements_size());
   for (const EncryptedElement& element : message.encrypted_set().elements()) {
-    EncryptedElement reencrypted;
     StatusOr<std::string> reenc = ec_cipher_->ReEncrypt(element.element());
     if (!reenc.ok()) {
       return reenc.status();
     }
-    *reencrypted.mutable_element() = reenc.ValueOrDie();
-    reencrypted_set.push_back(reencrypted);
+    reencrypted_set.push_back(
+        fingerprint_bytes > 0
+            ? Fingerprint(ctx_, reenc.ValueOrDie(), fingerprint_bytes)
+            : std::move(reenc.ValueOrDie()));
   }
-  std::sort(reencrypted_set.begin(), reencrypted_set.end(),
-            [](const EncryptedElement& a, const EncryptedElement& b) {
-              return a.element() < b.element();
-            });
-  for (const EncryptedElement& element : reencrypted_set) {
-    *result.mutable_reencrypted_set()->add_elements() = element;
+  std::sort(reencrypted_set.begin(), reencrypted_set.end());
+  if (compress_reencrypted_set_) {
+    StatusOr<std::string> compressed = EncodeSortedSet(reencrypted_set);
+    if (!compressed.ok()) {
+      return compressed.status();
+    }
+    *result.mutable_reencrypted_set_compressed() =
+        std::move(compressed.ValueOrDie());
+  } else {
+    for (std::string& element : reencrypted_set) {
+      *result.mutable_reencrypted_set()->add_elements()->mutable_element() =
+          std::move(element);
+    }
   }
+  result.set_reencrypted_set_sorted(true);
 
   return result;
 }
 
+StatusOr<std::vector<BigNum>> Client::EncryptValues(
+    const std::vector<size_t>& indices) const {
+  int total_bits = 0;
+  for (int width : column_bit_widths_) {
+    total_bits += width;
+  }
+  // Packs the values of all columns into one plaintext per element, as a plain
+  // integer whenever the packed value fits in 64 bits. The columns of width 0
+  // only hold zeros and are skipped, so every shift is below 64.
+  if (value_columns_.size() == 1 || total_bits <= 64) {
+    std::vector<uint64_t> packed_values(indices.size(), 0);
+    int offset = 0;
+    for (size_t k = 0; k < value_columns_.size(); k++) {
+      if (column_bit_widths_[k] == 0) {
+        continue;
+      }
+      for (size_t j = 0; j < indices.size(); j++) {
+        packed_values[j] |=
+            static_cast<uint64_t>(value_columns_[k][indices[j]]) << offset;
+      }
+      offset += column_bit_widths_[k];
+    }
+    return private_paillier_->EncryptBatch(packed_values);
+  }
+  std::vector<BigNum> packed_values;
+  packed_values.reserve(indices.size());
+  for (size_t i : indices) {
+    BigNum packed_value = ctx_->Zero();
+    int offset = 0;
+    for (size_t k = 0; k < value_columns_.size(); k++) {
+      BigNum value = ctx_->CreateBigNum(value_columns_[k][i]);
+      packed_value = packed_value + value.Lshift(offset);
+      offset += column_bit_widths_[k];
+    }
+    packed_values.push_back(std::move(packed_value));
+  }
+  return private_paillier_->EncryptBatch(packed_values);
+}
+
 StatusOr<std::pair<int64_t, BigNum>> Client::DecryptSum(
     const ServerRoundTwo& server_message) {
+  if (column_bit_widths_.size() > 1) {
+    return util::InvalidArgumentError(
+        "Called DecryptSum with multiple value columns, use DecryptSums.");
+  }
   if (private_paillier_ == nullptr) {
     return util::InvalidArgumentError("Called DecryptSum before ReEncryptSet.");
   }
 
   StatusOr<BigNum> sum = private_paillier_->Decrypt(
-      ctx_->CreateBigNum(server_message.encrypted_sum()));
+      ctx_->CreatePublicBigNum(server_message.encrypted_sum()));
   if (!sum.ok()) {
     return sum.status();
   }
   return std::make_pair(server_message.intersection_size(), sum.ValueOrDie());
 }
 
+StatusOr<std::pair<int64_t, std::vector<BigNum>>> Client::DecryptSums(
+    const ServerRoundTwo& server_message) {
+  if (private_paillier_ == nullptr) {
+    return util::InvalidArgumentError(
+        "Called DecryptSums before ReEncryptSet.");
+  }
+
+  StatusOr<BigNum> packed_sum = private_paillier_->Decrypt(
+      ctx_->CreatePublicBigNum(server_message.encrypted_sum()));
+  if (!packed_sum.ok()) {
+    return packed_sum.status();
+  }
+  std::vector<BigNum> sums;
+  if (column_bit_widths_.size() <= 1) {
+    sums.push_back(packed_sum.ValueOrDie());
+  } else {
+    int offset = 0;
+    for (int width : column_bit_widths_) {
+      sums.push_back(packed_sum.ValueOrDie().Rshift(offset).GetLastNBits(width));
+      offset += width;
+    }
+  }
+  return std::make_pair(server_message.intersection_size(), std::move(sums));
+}
+
+StatusOr<CardinalityEstimate> Client::EstimateIntersectionSize(
+    const ServerRoundTwo& server_message) const {
+  if (private_paillier_ == nullptr) {
+    return util::InvalidArgumentError(
+        "Called EstimateIntersectionSize before ReEncryptSet.");
+  }
+  return EstimateCardinality(server_message.intersection_size(),
+                             sampling_rate_);
+}
+
 std::string Client::GetSerializedState() const {
   ClientState state;
   *state.mutable_p() = p_.ToBytes();
   *state.mutable_q() = q_.ToBytes();
   *state.mutable_ec_key() = ec_cipher_->GetPrivateKeyBytes();
+  state.set_paillier_s(s_);
+  state.set_safe_primes(prime_type_ == PaillierPrimeType::kSafePrimes);
+  state.set_fingerprint_false_positive_rate(fingerprint_false_positive_rate_);
+  state.set_compress_reencrypted_set(compress_reencrypted_set_);
+  state.set_sampling_rate(sampling_rate_);
+  state.set_sampling_salt_share(sampling_salt_share_);
+  for (int width : column_bit_widths_) {
+    state.add_column_bit_widths(width);
+  }
   return state.SerializeAsString();
 }
 
@@ -19,6 +19,7 @@
 #include "crypto/context.h"
 #include "crypto/paillier.h"
 #include "match.pb.h"
+#include "set_sampling.h"
 #include "util/status.inc"
 #include "crypto/ec_commutative_cipher.h"
 
@@ -29,31 +30,128 @@ namespace private_join_and_compute {
 // This is the party that will receive the sum as output.
 class Client {
  public:
+  // The Paillier key is generated from primes of the given type; kPrimes makes
+  // key generation much faster, which suits short-lived sessions.
+  //
+  // The values must be nonnegative and fit in an int64, or the constructor
+  // fails a CHECK, even where the Paillier plaintext space could hold larger
+  // values.
   Client(Context* ctx, const std::vector<std::string>& elements,
-         const std::vector<BigNum>& values, int32_t modulus_size);
+         const std::vector<BigNum>& values, int32_t modulus_size,
+         PaillierPrimeType prime_type = PaillierPrimeType::kSafePrimes);
+
+  // Creates a client with several columns of associated values, where
+  // value_columns[k][i] is the k-th value associated with elements[i]. All
+  // columns are summed in a single run of the protocol by packing them into
+  // disjoint bit slots of one Damgaard-Jurik plaintext, each slot wide enough
+  // to hold the sum of its column over the whole set.
+  //
+  // The values must be nonnegative and fit in an int64; they are kept as plain
+  // integers, and the constructors taking int64 columns avoid creating any
+  // BigNum for them.
+  Client(Context* ctx, const std::vector<std::string>& elements,
+         const std::vector<std::vector<BigNum>>& value_columns,
+         int32_t modulus_size,
+         PaillierPrimeType prime_type = PaillierPrimeType::kSafePrimes);
+  Client(Context* ctx, const std::vector<std::string>& elements,
+         std::vector<std::vector<int64_t>> value_columns, int32_t modulus_size,
+         PaillierPrimeType prime_type = PaillierPrimeType::kSafePrimes);
+  // Same as above, but uses a pre-generated Paillier key, e.g. one taken from
+  // a key pool, instead of generating a new one.
+  Client(Context* ctx, const std::vector<std::string>& elements,
+         const std::vector<std::vector<BigNum>>& value_columns,
+         const PaillierKey& paillier_key);
+  Client(Context* ctx, const std::vector<std::string>& elements,
+         std::vector<std::vector<int64_t>> value_columns,
+         const PaillierKey& paillier_key);
   Client(Context* ctx, const std::string& serialized);
 
   // The server sends the first message of the protocol, which contains its
   // encrypted set.  This party then re-encrypts that set and replies with the
   // reencrypted values and its own encrypted set.
+  //
+  // Fails with INVALID_ARGUMENT if the packed value columns need a larger
+  // Damgaard-Jurik s than the server accepts (see kMaxPaillierS).
   ::util::StatusOr<ClientRoundOne> ReEncryptSet(
       const ServerRoundOne& server_message);
 
+  // Makes ReEncryptSet send fingerprints of the re-encrypted points instead of
+  // the points, as short as the expected number of false matches allows (see
+  // FingerprintBytes). A rate of 0, the default, sends the full points.
+  void SetFingerprintFalsePositiveRate(double false_positive_rate) {
+    fingerprint_false_positive_rate_ = false_positive_rate;
+  }
+
+  // Makes ReEncryptSet send its sorted re-encryption of the server's set
+  // prefix-delta compressed (see sorted_set_codec.h). Off by default.
+  void SetCompressReencryptedSet(bool compress) {
+    compress_reencrypted_set_ = compress;
+  }
+
+  // Requests the approximate mode with the given sampling rate in (0, 1], and
+  // draws the client's share of the sampling salt (see set_sampling.h). Both
+  // go in the StartProtocolRequest. ReEncryptSet then fails unless the server
+  // sampled at exactly this rate; the default rate of 1 disables sampling.
+  void SetSamplingRate(double sampling_rate);
+
+  // Returns the client's share of the sampling salt, or an empty string
+  // without sampling.
+  const std::string& sampling_salt_share() const {
+    return sampling_salt_share_;
+  }
+
   // After the server computes the intersection-sum, it will send it back to
   // this party for decryption, together with the intersection_size. This party
   // will decrypt and output the intersection sum and intersection size.
   ::util::StatusOr<std::pair<int64_t, BigNum>> DecryptSum(
       const ServerRoundTwo& server_message);
 
+  // Same as DecryptSum, but unpacks and returns one intersection sum per
+  // column of associated values, in the order the columns were given.
+  ::util::StatusOr<std::pair<int64_t, std::vector<BigNum>>> DecryptSums(
+      const ServerRoundTwo& server_message);
+
+  // Returns the estimate of the size of the whole intersection, for a run of
+  // the approximate mode where the server sampled both sets (see
+  // set_sampling.h). DecryptSum and DecryptSums then return the sums over the
+  // sampled intersection. Without sampling, the estimate is exact.
+  ::util::StatusOr<CardinalityEstimate> EstimateIntersectionSize(
+      const ServerRoundTwo& server_message) const;
+
   std::string GetSerializedState() const;
 
  private:
+  // Checks that the value columns match the elements and are nonnegative.
+  void CheckValueColumns() const;
+
+  // Packs the values of the elements at the given indices and encrypts them
+  // with the Paillier key.
+  ::util::StatusOr<std::vector<BigNum>> EncryptValues(
+      const std::vector<size_t>& indices) const;
+
   Context* ctx_;  // not owned
   std::vector<std::string> elements_;
-  std::vector<BigNum> values_;
+  std::vector<std::vector<int64_t>> value_columns_;
+  // The width of the plaintext bit slot holding each column's sum. Column 0
+  // occupies the least significant bits.
+  std::vector<int> column_bit_widths_;
 
+  // The kind of primes forming the Paillier private key.
+  PaillierPrimeType prime_type_;
   // The Paillier private key
   BigNum p_, q_;
+  // The Damgaard-Jurik parameter s, chosen as the smallest value such that the
+  // plaintext space n^s fits all the packed column slots.
+  int s_;
+  // The expected number of false matches allowed by fingerprints, or 0 to send
+  // the full points.
+  double fingerprint_false_positive_rate_ = 0;
+  // Whether to compress the re-encryption of the server's set.
+  bool compress_reencrypted_set_ = false;
+  // The rate at which both sets are sampled, or 1 without sampling.
+  double sampling_rate_ = 1;
+  // The client's share of the sampling salt.
+  std::string sampling_salt_share_;
 
   std::unique_ptr<ECCommutativeCipher> ec_cipher_;
   std::unique_ptr<PrivatePaillier> private_paillier_;
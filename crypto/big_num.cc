@@ -15,6 +15,7 @@
 
 #include "crypto/big_num.h"
 
+#include <atomic>
 #include <cmath>
 #include <vector>
 
@@ -29,12 +30,102 @@ namespace private_join_and_compute {
 
 using util::StatusOr;
 
+namespace {
+
+// The most BIGNUMs a thread keeps for reuse inside a BigNumArena.
+const size_t kMaxArenaBignums = 4096;
+
+#ifdef PJC_COUNT_BIGNUM_ALLOCATIONS
+std::atomic<int64_t> allocation_count(0);
+#endif
+
+// Counts the allocation of a BIGNUM, in builds that measure them.
+inline void CountAllocation() {
+#ifdef PJC_COUNT_BIGNUM_ALLOCATIONS
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+// The BIGNUMs kept for reuse by the BigNumArenas of a thread.
+struct ThreadArena {
+  ~ThreadArena() { Release(); }
+
+  void Release() {
+    for (BIGNUM* bn : free_bignums) {
+      BN_free(bn);
+    }
+    free_bignums.clear();
+  }
+
+  // The number of live BigNumArenas on the thread.
+  int depth = 0;
+  std::vector<BIGNUM*> free_bignums;
+};
+
+thread_local ThreadArena thread_arena;
+
+// Returns a BIGNUM with value zero, reused from the thread's arena if possible
+// and newly allocated otherwise, counting the allocation.
+BIGNUM* CountedBnNew() {
+  if (!thread_arena.free_bignums.empty()) {
+    BIGNUM* bn = thread_arena.free_bignums.back();
+    thread_arena.free_bignums.pop_back();
+    return bn;
+  }
+  CountAllocation();
+  return CHECK_NOTNULL(BN_new());
+}
+
+// Returns a copy of bn, stored in a BIGNUM reused from the thread's arena if
+// possible and newly allocated otherwise, counting the allocation.
+BIGNUM* CountedBnDup(const BIGNUM* bn) {
+  if (!thread_arena.free_bignums.empty()) {
+    BIGNUM* copy = CountedBnNew();
+    CRYPTO_CHECK(nullptr != BN_copy(copy, bn));
+    return copy;
+  }
+  CountAllocation();
+  return CHECK_NOTNULL(BN_dup(bn));
+}
+
+}  // namespace
+
+void BigNum::BnDeleter::operator()(BIGNUM* bn) {
+  if (thread_arena.depth > 0 &&
+      thread_arena.free_bignums.size() < kMaxArenaBignums) {
+    if (secret_) {
+      BN_clear(bn);
+    } else {
+      BN_zero(bn);
+    }
+    thread_arena.free_bignums.push_back(bn);
+  } else if (secret_) {
+    BN_clear_free(bn);
+  } else {
+    BN_free(bn);
+  }
+}
+
+BigNumArena::BigNumArena() { thread_arena.depth++; }
+
+BigNumArena::~BigNumArena() {
+  if (--thread_arena.depth == 0) {
+    thread_arena.Release();
+  }
+}
+
 BigNum::BigNum(const BigNum& other)
-    : bn_(BignumPtr(CHECK_NOTNULL(BN_dup(other.bn_.get())))),
+    : bn_(BignumPtr(CountedBnDup(other.bn_.get()), other.bn_.get_deleter())),
       bn_ctx_(other.bn_ctx_) {}
 
 BigNum& BigNum::operator=(const BigNum& other) {
-  bn_ = BignumPtr(CHECK_NOTNULL(BN_dup(other.bn_.get())));
+  // Copies into the existing storage unless this was moved from.
+  if (bn_ == nullptr) {
+    bn_ = BignumPtr(CountedBnDup(other.bn_.get()), other.bn_.get_deleter());
+  } else {
+    TaintWith(other);
+    CRYPTO_CHECK(nullptr != BN_copy(bn_.get(), other.bn_.get()));
+  }
   bn_ctx_ = other.bn_ctx_;
   return *this;
 }
@@ -48,12 +139,13 @@ BigNum& BigNum::operator=(BigNum&& other) {
   return *this;
 }
 
-BigNum::BigNum(BN_CTX* bn_ctx, uint64_t number) : BigNum::BigNum(bn_ctx) {
+BigNum::BigNum(BN_CTX* bn_ctx, uint64_t number, Secrecy secrecy)
+    : BigNum::BigNum(bn_ctx, secrecy) {
   CRYPTO_CHECK(BN_set_u64(bn_.get(), number));
 }
 
-BigNum::BigNum(BN_CTX* bn_ctx, const std::string& bytes)
-    : BigNum::BigNum(bn_ctx) {
+BigNum::BigNum(BN_CTX* bn_ctx, const std::string& bytes, Secrecy secrecy)
+    : BigNum::BigNum(bn_ctx, secrecy) {
   CRYPTO_CHECK(nullptr !=
                BN_bin2bn(reinterpret_cast<const unsigned char*>(bytes.data()),
                          bytes.size(), bn_.get()));
@@ -64,8 +156,8 @@ BigNum::BigNum(BN_CTX* bn_ctx, const unsigned char* bytes, int length)
   CRYPTO_CHECK(nullptr != BN_bin2bn(bytes, length, bn_.get()));
 }
 
-BigNum::BigNum(BN_CTX* bn_ctx) {
-  bn_ = BignumPtr(CHECK_NOTNULL(BN_new()));
+BigNum::BigNum(BN_CTX* bn_ctx, Secrecy secrecy) {
+  bn_ = BignumPtr(CountedBnNew(), BnDeleter(secrecy));
   bn_ctx_ = bn_ctx;
 }
 
@@ -74,14 +166,54 @@ BigNum::BigNum(BN_CTX* bn_ctx, BignumPtr bn) {
   bn_ctx_ = bn_ctx;
 }
 
+BigNum BigNum::NewResult() const {
+  return BigNum(bn_ctx_, IsSecret() ? Secrecy::kSecret : Secrecy::kPublic);
+}
+
+BigNum BigNum::NewResult(const BigNum& operand) const {
+  return BigNum(bn_ctx_, IsSecret() || operand.IsSecret() ? Secrecy::kSecret
+                                                          : Secrecy::kPublic);
+}
+
+BigNum BigNum::NewResult(const BigNum& operand1,
+                         const BigNum& operand2) const {
+  return BigNum(bn_ctx_,
+                IsSecret() || operand1.IsSecret() || operand2.IsSecret()
+                    ? Secrecy::kSecret
+                    : Secrecy::kPublic);
+}
+
+void BigNum::TaintWith(const BigNum& other) {
+  if (other.IsSecret()) {
+    bn_.get_deleter().secret_ = true;
+  }
+}
+
 const BIGNUM* BigNum::GetConstBignumPtr() const { return bn_.get(); }
 
+#ifdef PJC_COUNT_BIGNUM_ALLOCATIONS
+int64_t BigNum::AllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+#endif  // PJC_COUNT_BIGNUM_ALLOCATIONS
+
 std::string BigNum::ToBytes() const {
   CHECK(IsNonNegative()) << "Cannot serialize a negative BigNum.";
-  int length = BN_num_bytes(bn_.get());
-  std::vector<unsigned char> bytes(length);
-  BN_bn2bin(bn_.get(), bytes.data());
-  return std::string(reinterpret_cast<char*>(bytes.data()), bytes.size());
+  std::string bytes(BN_num_bytes(bn_.get()), '\0');
+  BN_bn2bin(bn_.get(), reinterpret_cast<unsigned char*>(&bytes[0]));
+  return bytes;
+}
+
+void BigNum::ToBytesFixed(int width, char* out) const {
+  CHECK(IsNonNegative()) << "Cannot serialize a negative BigNum.";
+  CHECK(BN_bn2bin_padded(reinterpret_cast<uint8_t*>(out), width, bn_.get()))
+      << "BigNum does not fit in " << width << " bytes.";
+}
+
+void ParseInto(absl::string_view bytes, BigNum* result) {
+  CRYPTO_CHECK(nullptr !=
+               BN_bin2bn(reinterpret_cast<const unsigned char*>(bytes.data()),
+                         bytes.size(), result->bn_.get()));
 }
 
 StatusOr<uint64_t> BigNum::ToIntValue() const {
@@ -111,6 +243,8 @@ bool BigNum::IsOne() const { return BN_is_one(bn_.get()); }
 
 bool BigNum::IsNonNegative() const { return !BN_is_negative(bn_.get()); }
 
+bool BigNum::IsSecret() const { return bn_.get_deleter().secret_; }
+
 BigNum BigNum::GetLastNBits(int n) const {
   BigNum r = *this;
   // Returns 0 on error (if r is already shorter than n bits), but the return
@@ -131,26 +265,26 @@ BigNum BigNum::Neg() const {
 }
 
 BigNum BigNum::Add(const BigNum& val) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val);
   CRYPTO_CHECK(1 == BN_add(r.bn_.get(), bn_.get(), val.bn_.get()));
   return r;
 }
 
 BigNum BigNum::Mul(const BigNum& val) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val);
   CRYPTO_CHECK(1 == BN_mul(r.bn_.get(), bn_.get(), val.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::Sub(const BigNum& val) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val);
   CRYPTO_CHECK(1 == BN_sub(r.bn_.get(), bn_.get(), val.bn_.get()));
   return r;
 }
 
 BigNum BigNum::Div(const BigNum& val) const {
-  BigNum r(bn_ctx_);
-  BignumPtr rem(CHECK_NOTNULL(BN_new()));
+  BigNum r = NewResult(val);
+  BignumPtr rem(CountedBnNew());
   CRYPTO_CHECK(
       1 == BN_div(r.bn_.get(), rem.get(), bn_.get(), val.bn_.get(), bn_ctx_));
   CHECK(BN_is_zero(rem.get())) << "Use DivAndTruncate() instead of Div() if "
@@ -159,8 +293,8 @@ BigNum BigNum::Div(const BigNum& val) const {
 }
 
 BigNum BigNum::DivAndTruncate(const BigNum& val) const {
-  BigNum r(bn_ctx_);
-  BignumPtr rem(CHECK_NOTNULL(BN_new()));
+  BigNum r = NewResult(val);
+  BignumPtr rem(CountedBnNew());
   CRYPTO_CHECK(
       1 == BN_div(r.bn_.get(), rem.get(), bn_.get(), val.bn_.get(), bn_ctx_));
   return r;
@@ -171,34 +305,34 @@ int BigNum::CompareTo(const BigNum& val) const {
 }
 
 BigNum BigNum::Exp(const BigNum& exponent) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(exponent);
   CRYPTO_CHECK(1 ==
                BN_exp(r.bn_.get(), bn_.get(), exponent.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::Mod(const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(m);
   CRYPTO_CHECK(1 == BN_nnmod(r.bn_.get(), bn_.get(), m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModAdd(const BigNum& val, const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val, m);
   CRYPTO_CHECK(1 == BN_mod_add(r.bn_.get(), bn_.get(), val.bn_.get(),
                                m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModSub(const BigNum& val, const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val, m);
   CRYPTO_CHECK(1 == BN_mod_sub(r.bn_.get(), bn_.get(), val.bn_.get(),
                                m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModMul(const BigNum& val, const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val, m);
   CRYPTO_CHECK(1 == BN_mod_mul(r.bn_.get(), bn_.get(), val.bn_.get(),
                                m.bn_.get(), bn_ctx_));
   return r;
@@ -207,27 +341,27 @@ BigNum BigNum::ModMul(const BigNum& val, const BigNum& m) const {
 BigNum BigNum::ModExp(const BigNum& exponent, const BigNum& m) const {
   CHECK(exponent.IsNonNegative()) << "Cannot use a negative exponent in BigNum "
                                      "ModExp.";
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(exponent, m);
   CRYPTO_CHECK(1 == BN_mod_exp(r.bn_.get(), bn_.get(), exponent.bn_.get(),
                                m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModSqr(const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(m);
   CRYPTO_CHECK(1 == BN_mod_sqr(r.bn_.get(), bn_.get(), m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModInverse(const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(m);
   CRYPTO_CHECK(nullptr !=
                BN_mod_inverse(r.bn_.get(), bn_.get(), m.bn_.get(), bn_ctx_));
   return r;
 }
 
 BigNum BigNum::ModSqrt(const BigNum& m) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(m);
   CRYPTO_CHECK(nullptr !=
                BN_mod_sqrt(r.bn_.get(), bn_.get(), m.bn_.get(), bn_ctx_));
   return r;
@@ -241,21 +375,76 @@ BigNum BigNum::ModNegate(const BigNum& m) const {
 }
 
 BigNum BigNum::Lshift(int n) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult();
   CRYPTO_CHECK(1 == BN_lshift(r.bn_.get(), bn_.get(), n));
   return r;
 }
 
 BigNum BigNum::Rshift(int n) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult();
   CRYPTO_CHECK(1 == BN_rshift(r.bn_.get(), bn_.get(), n));
   return r;
 }
 
 BigNum BigNum::Gcd(const BigNum& val) const {
-  BigNum r(bn_ctx_);
+  BigNum r = NewResult(val);
   CRYPTO_CHECK(1 == BN_gcd(r.bn_.get(), bn_.get(), val.bn_.get(), bn_ctx_));
   return r;
 }
 
+void BigNum::AddInPlace(const BigNum& val) {
+  TaintWith(val);
+  CRYPTO_CHECK(1 == BN_add(bn_.get(), bn_.get(), val.bn_.get()));
+}
+
+void BigNum::SubInPlace(const BigNum& val) {
+  TaintWith(val);
+  CRYPTO_CHECK(1 == BN_sub(bn_.get(), bn_.get(), val.bn_.get()));
+}
+
+void BigNum::AddWordInPlace(BN_ULONG w) {
+  CRYPTO_CHECK(1 == BN_add_word(bn_.get(), w));
+}
+
+void BigNum::SubWordInPlace(BN_ULONG w) {
+  CRYPTO_CHECK(1 == BN_sub_word(bn_.get(), w));
+}
+
+void BigNum::MulInPlace(const BigNum& val) {
+  TaintWith(val);
+  CRYPTO_CHECK(1 == BN_mul(bn_.get(), bn_.get(), val.bn_.get(), bn_ctx_));
+}
+
+void BigNum::ModInPlace(const BigNum& m) {
+  TaintWith(m);
+  CRYPTO_CHECK(1 == BN_nnmod(bn_.get(), bn_.get(), m.bn_.get(), bn_ctx_));
+}
+
+void BigNum::ModMulInPlace(const BigNum& val, const BigNum& m) {
+  TaintWith(val);
+  TaintWith(m);
+  CRYPTO_CHECK(1 == BN_mod_mul(bn_.get(), bn_.get(), val.bn_.get(),
+                               m.bn_.get(), bn_ctx_));
+}
+
+void BigNum::LshiftInPlace(int n) {
+  CRYPTO_CHECK(1 == BN_lshift(bn_.get(), bn_.get(), n));
+}
+
+void BigNum::MulInto(const BigNum& val, BigNum* result) const {
+  result->TaintWith(*this);
+  result->TaintWith(val);
+  CRYPTO_CHECK(1 == BN_mul(result->bn_.get(), bn_.get(), val.bn_.get(),
+                           bn_ctx_));
+}
+
+void BigNum::ModMulInto(const BigNum& val, const BigNum& m,
+                        BigNum* result) const {
+  result->TaintWith(*this);
+  result->TaintWith(val);
+  result->TaintWith(m);
+  CRYPTO_CHECK(1 == BN_mod_mul(result->bn_.get(), bn_.get(), val.bn_.get(),
+                               m.bn_.get(), bn_ctx_));
+}
+
 }  // namespace private_join_and_compute
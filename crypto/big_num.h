@@ -22,6 +22,7 @@
 
 #include "gflags/gflags_declare.h"
 #include "crypto/openssl.inc"
+#include "absl/strings/string_view.h"
 
 namespace util {
 template <typename T>
@@ -30,17 +31,36 @@ class StatusOr;
 
 namespace private_join_and_compute {
 
-// Immutable wrapper class for openssl BIGNUM numbers.
+// Wrapper class for openssl BIGNUM numbers.
 // Used for arithmetic operations on big numbers.
 // Makes use of a BN_CTX structure that holds temporary BIGNUMs needed for
 // arithmetic operations as dynamic memory allocation to create BIGNUMs is
 // expensive.
+//
+// The const operations return a new BigNum, allocating a BIGNUM for it. Hot
+// loops should instead use the InPlace and Into variants, which write their
+// result into the storage of an existing BigNum.
 class BigNum {
  public:
-  // Deletes a BIGNUM.
+  // Whether a BigNum may hold secret material such as keys, primes or
+  // randomness. Secret BigNums are wiped before their memory is freed, while
+  // public ones, such as ciphertexts and curve parameters, are freed without
+  // paying for the wipe.
+  enum class Secrecy { kSecret, kPublic };
+
+  // Deletes a BIGNUM, wiping it first unless it is public. Inside a
+  // BigNumArena the BIGNUM is recycled instead of freed.
   class BnDeleter {
    public:
-    void operator()(BIGNUM* bn) { BN_clear_free(bn); }
+    BnDeleter() : secret_(true) {}
+    explicit BnDeleter(Secrecy secrecy)
+        : secret_(secrecy == Secrecy::kSecret) {}
+
+    void operator()(BIGNUM* bn);
+
+   private:
+    friend class BigNum;
+    bool secret_;
   };
 
   // Copies the given BigNum.
@@ -56,6 +76,12 @@ class BigNum {
   // Returns the absolute value of this in big-endian form.
   std::string ToBytes() const;
 
+  // Writes this in big-endian form, left-padded with zeros to exactly width
+  // bytes, to out. Fixed-width output lets values such as ciphertexts be
+  // written directly into preallocated buffers and packed back to back.
+  // Causes a check failure if this is negative or longer than width bytes.
+  void ToBytesFixed(int width, char* out) const;
+
   // Converts this BigNum to a uint64_t value. Returns an INVALID_ARGUMENT
   // error code if the value of *this is larger than 64 bits.
   util::StatusOr<uint64_t> ToIntValue() const;
@@ -80,6 +106,11 @@ class BigNum {
   // Returns True if this BigNum is not negative.
   bool IsNonNegative() const;
 
+  // Returns True if this BigNum is wiped when freed. A BigNum is secret unless
+  // created as public; the result of an operation is secret if any of its
+  // operands is, and a BigNum stays secret once its storage held a secret.
+  bool IsSecret() const;
+
   // Returns a BigNum that is equal to the last n bits of this BigNum.
   BigNum GetLastNBits(int n) const;
 
@@ -166,26 +197,110 @@ class BigNum {
   // Causes a check failure if the operation fails.
   BigNum Gcd(const BigNum& val) const;
 
+  // Sets *this to (*this + val).
+  // Causes a check failure if the operation fails.
+  void AddInPlace(const BigNum& val);
+
+  // Sets *this to (*this - val).
+  // Causes a check failure if the operation fails.
+  void SubInPlace(const BigNum& val);
+
+  // Sets *this to (*this + w) and (*this - w) respectively.
+  // Causes a check failure if the operation fails.
+  void AddWordInPlace(BN_ULONG w);
+  void SubWordInPlace(BN_ULONG w);
+
+  // Sets *this to (*this * val).
+  // Causes a check failure if the operation fails.
+  void MulInPlace(const BigNum& val);
+
+  // Sets *this to (*this mod m).
+  // Causes a check failure if the operation fails.
+  void ModInPlace(const BigNum& m);
+
+  // Sets *this to (*this * val mod m).
+  // Causes a check failure if the operation fails.
+  void ModMulInPlace(const BigNum& val, const BigNum& m);
+
+  // Sets *this to (*this << n).
+  // Causes a check failure if the operation fails.
+  void LshiftInPlace(int n);
+
+  // Sets *result to (*this * val), reusing the storage of *result, which must
+  // not have been moved from.
+  // Causes a check failure if the operation fails.
+  void MulInto(const BigNum& val, BigNum* result) const;
+
+  // Sets *result to (*this * val mod m), reusing the storage of *result, which
+  // must not have been moved from.
+  // Causes a check failure if the operation fails.
+  void ModMulInto(const BigNum& val, const BigNum& m, BigNum* result) const;
+
   // Returns a pointer to const BIGNUM to be used with openssl functions.
   const BIGNUM* GetConstBignumPtr() const;
 
+#ifdef PJC_COUNT_BIGNUM_ALLOCATIONS
+  // Returns the number of BIGNUMs allocated by BigNum objects in this process,
+  // for measuring the allocations done by a piece of code. BIGNUMs reused from
+  // a BigNumArena are not counted. Only built with
+  // --copt=-DPJC_COUNT_BIGNUM_ALLOCATIONS, to keep the shared counter off the
+  // allocation path otherwise.
+  static int64_t AllocationCount();
+#endif  // PJC_COUNT_BIGNUM_ALLOCATIONS
+
  private:
   // Creates a new BigNum object from a bytes string.
-  explicit BigNum(BN_CTX* bn_ctx, const std::string& bytes);
+  explicit BigNum(BN_CTX* bn_ctx, const std::string& bytes,
+                  Secrecy secrecy = Secrecy::kSecret);
   // Creates a new BigNum object from a char array.
   explicit BigNum(BN_CTX* bn_ctx, const unsigned char* bytes, int length);
   // Creates a new BigNum object from the number.
-  explicit BigNum(BN_CTX* bn_ctx, uint64_t number);
+  explicit BigNum(BN_CTX* bn_ctx, uint64_t number,
+                  Secrecy secrecy = Secrecy::kSecret);
   // Creates a new BigNum object with no defined value.
-  explicit BigNum(BN_CTX* bn_ctx);
+  explicit BigNum(BN_CTX* bn_ctx, Secrecy secrecy = Secrecy::kSecret);
   // Creates a new BigNum object from the given BIGNUM value.
   explicit BigNum(BN_CTX* bn_ctx, BignumPtr bn);
 
+  // Creates a BigNum with no defined value to hold the result of an operation
+  // on *this and the given operands, which is secret if any of them is.
+  BigNum NewResult() const;
+  BigNum NewResult(const BigNum& operand) const;
+  BigNum NewResult(const BigNum& operand1, const BigNum& operand2) const;
+
+  // Makes this BigNum secret if the other one is, before storing a value
+  // computed from it.
+  void TaintWith(const BigNum& other);
+
   BignumPtr bn_;
   BN_CTX* bn_ctx_;
 
   // Context is a factory for BigNum objects.
   friend class Context;
+  friend void ParseInto(absl::string_view bytes, BigNum* result);
+};
+
+// Sets *result to the big-endian bytes, reusing the storage of *result, which
+// must not have been moved from. Parsing a stream of values into the same
+// BigNum allocates no BIGNUM per value, unlike Context::CreateBigNum. The
+// secrecy of *result is kept.
+void ParseInto(absl::string_view bytes, BigNum* result);
+
+// While alive, BIGNUMs of the BigNums freed on the calling thread are wiped
+// if secret and kept for reuse by the BigNums created later on the same thread,
+// together with their limb storage, instead of going back to malloc. The kept
+// BIGNUMs are freed in bulk when the outermost BigNumArena of the thread is
+// destroyed, so an arena should cover one batch of work, such as a round of
+// the protocol. BigNums may outlive the arena they were created in.
+class BigNumArena {
+ public:
+  BigNumArena();
+
+  // BigNumArena is neither copyable nor movable.
+  BigNumArena(const BigNumArena&) = delete;
+  BigNumArena& operator=(const BigNumArena&) = delete;
+
+  ~BigNumArena();
 };
 
 inline BigNum operator-(const BigNum& a) { return a.Neg(); }
@@ -200,11 +315,20 @@ inline BigNum operator-(const BigNum& a, const BigNum& b) { return a.Sub(b); }
 // Causes a check failure if the remainder != 0.
 inline BigNum operator/(const BigNum& a, const BigNum& b) { return a.Div(b); }
 
-inline BigNum& operator+=(BigNum& a, const BigNum& b) { return a = a + b; }
+inline BigNum& operator+=(BigNum& a, const BigNum& b) {
+  a.AddInPlace(b);
+  return a;
+}
 
-inline BigNum& operator*=(BigNum& a, const BigNum& b) { return a = a * b; }
+inline BigNum& operator*=(BigNum& a, const BigNum& b) {
+  a.MulInPlace(b);
+  return a;
+}
 
-inline BigNum& operator-=(BigNum& a, const BigNum& b) { return a = a - b; }
+inline BigNum& operator-=(BigNum& a, const BigNum& b) {
+  a.SubInPlace(b);
+  return a;
+}
 
 inline BigNum& operator/=(BigNum& a, const BigNum& b) { return a = a / b; }
 
@@ -236,11 +360,17 @@ inline BigNum operator>>(const BigNum& a, int n) { return a.Rshift(n); }
 
 inline BigNum operator<<(const BigNum& a, int n) { return a.Lshift(n); }
 
-inline BigNum& operator%=(BigNum& a, const BigNum& b) { return a = a % b; }
+inline BigNum& operator%=(BigNum& a, const BigNum& b) {
+  a.ModInPlace(b);
+  return a;
+}
 
 inline BigNum& operator>>=(BigNum& a, int n) { return a = a >> n; }
 
-inline BigNum& operator<<=(BigNum& a, int n) { return a = a << n; }
+inline BigNum& operator<<=(BigNum& a, int n) {
+  a.LshiftInPlace(n);
+  return a;
+}
 
 }  // namespace private_join_and_compute
 
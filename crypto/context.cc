@@ -36,10 +36,10 @@ std::string OpenSSLErrorString() {
 Context::Context()
     : bn_ctx_(CHECK_NOTNULL(BN_CTX_new())),
       evp_md_ctx_(CHECK_NOTNULL(EVP_MD_CTX_create())),
-      zero_bn_(CreateBigNum(0)),
-      one_bn_(CreateBigNum(1)),
-      two_bn_(CreateBigNum(2)),
-      three_bn_(CreateBigNum(3)) {
+      zero_bn_(CreatePublicBigNum(0)),
+      one_bn_(CreatePublicBigNum(1)),
+      two_bn_(CreatePublicBigNum(2)),
+      three_bn_(CreatePublicBigNum(3)) {
 #if defined(OS_NACL)
   nacl::SeedOpenSSLRand();
 #endif
@@ -60,6 +60,14 @@ BigNum Context::CreateBigNum(uint64_t number) {
   return BigNum(bn_ctx_.get(), number);
 }
 
+BigNum Context::CreatePublicBigNum(const std::string& bytes) {
+  return BigNum(bn_ctx_.get(), bytes, BigNum::Secrecy::kPublic);
+}
+
+BigNum Context::CreatePublicBigNum(uint64_t number) {
+  return BigNum(bn_ctx_.get(), number, BigNum::Secrecy::kPublic);
+}
+
 BigNum Context::CreateBigNum(BigNum::BignumPtr bn) {
   return BigNum(bn_ctx_.get(), std::move(bn));
 }
@@ -95,10 +103,9 @@ BigNum Context::RandomOracle(const std::string& x, const BigNum& max_value) {
   int excess_bit_count = (iter_count * 512) - output_bit_length;
   BigNum hash_output = CreateBigNum(0);
   for (int i = 1; i < iter_count + 1; i++) {
-    hash_output = hash_output.Lshift(512);
-    hash_output =
-        hash_output +
-        CreateBigNum(Sha512String(CreateBigNum(i).ToBytes().append(x)));
+    hash_output.LshiftInPlace(512);
+    hash_output.AddInPlace(
+        CreateBigNum(Sha512String(CreateBigNum(i).ToBytes().append(x))));
   }
   return hash_output.Rshift(excess_bit_count).Mod(max_value);
 }
@@ -76,6 +76,12 @@ class Context {
   // Creates a BigNum initialized with the given number.
   BigNum CreateBigNum(uint64_t number);
 
+  // Same as CreateBigNum, but creates a public BigNum that is not wiped when
+  // freed. Use only for values that are not secret, e.g. ciphertexts and
+  // public keys received from the other party.
+  BigNum CreatePublicBigNum(const std::string& bytes);
+  BigNum CreatePublicBigNum(uint64_t number);
+
   // Hashes a string using SHA-256 to a byte string.
   virtual std::string Sha256String(const std::string& bytes);
 
@@ -54,7 +54,8 @@ StatusOr<BigNum> CreateOrder(const EC_GROUP* group, Context* context) {
         absl::StrCat("ECGroup::CreateOrder - Could not create BIGNUM. ",
                      OpenSSLErrorString()));
   }
-  BigNum::BignumPtr order = BigNum::BignumPtr(bn);
+  BigNum::BignumPtr order =
+      BigNum::BignumPtr(bn, BigNum::BnDeleter(BigNum::Secrecy::kPublic));
   if (EC_GROUP_get_order(group, order.get(), context->GetBnCtx()) != 1) {
     return util::InternalError(
         absl::StrCat("ECGroup::CreateOrder - Could not get order. ",
@@ -75,9 +76,11 @@ StatusOr<ECGroup::CurveParams> CreateCurveParams(const EC_GROUP* group,
         absl::StrCat("ECGroup::CreateCurveParams - Could not create BIGNUM. ",
                      OpenSSLErrorString()));
   }
-  BigNum::BignumPtr p = BigNum::BignumPtr(bn1);
-  BigNum::BignumPtr a = BigNum::BignumPtr(bn2);
-  BigNum::BignumPtr b = BigNum::BignumPtr(bn3);
+  // The curve parameters are public, so they are freed without wiping.
+  const BigNum::BnDeleter deleter(BigNum::Secrecy::kPublic);
+  BigNum::BignumPtr p = BigNum::BignumPtr(bn1, deleter);
+  BigNum::BignumPtr a = BigNum::BignumPtr(bn2, deleter);
+  BigNum::BignumPtr b = BigNum::BignumPtr(bn3, deleter);
   if (EC_GROUP_get_curve_GFp(group, p.get(), a.get(), b.get(),
                              context->GetBnCtx()) != 1) {
     return util::InternalError(
@@ -136,7 +139,7 @@ StatusOr<ECPoint> ECGroup::GetPointByHashingToCurve(
     const std::string& m) const {
   BigNum x = context_->RandomOracle(m, curve_params_.p);
   while (true) {
-    x = x.Mod(curve_params_.p);
+    x.ModInPlace(curve_params_.p);
     BigNum y2 = ComputeYSquare(x);
     if (IsSquare(y2)) {
       BigNum sqrt = y2.ModSqrt(curve_params_.p);
@@ -150,8 +153,13 @@ StatusOr<ECPoint> ECGroup::GetPointByHashingToCurve(
 }
 
 BigNum ECGroup::ComputeYSquare(const BigNum& x) const {
-  return (x.Exp(context_->Three()) + curve_params_.a * x + curve_params_.b)
-      .Mod(curve_params_.p);
+  // Evaluates x^3 + ax + b as (x^2 + a)x + b in a single BigNum.
+  BigNum y_square = x.ModSqr(curve_params_.p);
+  y_square.AddInPlace(curve_params_.a);
+  y_square.ModMulInPlace(x, curve_params_.p);
+  y_square.AddInPlace(curve_params_.b);
+  y_square.ModInPlace(curve_params_.p);
+  return y_square;
 }
 
 bool ECGroup::IsValid(const ECPoint& point) const {
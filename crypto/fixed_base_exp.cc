@@ -33,11 +33,15 @@
 #include "crypto/big_num.h"
 #include "crypto/context.h"
 #include "crypto/mont_mul.h"
+#include "crypto/multi_buffer_exp.h"
 #include "util/status.inc"
 #include "util/status_macros.h"
 
 DEFINE_bool(two_k_ary_exp, false,
             "Whether to use 2^k-ary fixed based exponentiation.");
+DEFINE_bool(multi_buffer_exp, true,
+            "Whether FixedBaseExp::ModExpBatch evaluates eight exponentiations "
+            "at a time with AVX-512 IFMA on CPUs supporting it.");
 
 namespace private_join_and_compute {
 
@@ -71,12 +75,23 @@ class FixedBaseExpImplBase {
 
 class SimpleBaseExpImpl : public FixedBaseExpImplBase {
  public:
-  SimpleBaseExpImpl(const BigNum& fixed_base, const BigNum& modulus)
-      : FixedBaseExpImplBase(fixed_base, modulus) {}
+  SimpleBaseExpImpl(Context* ctx, const BigNum& fixed_base,
+                    const BigNum& modulus)
+      : FixedBaseExpImplBase(fixed_base, modulus),
+        mont_ctx_(modulus.IsBitSet(0) ? new MontContext(ctx, modulus)
+                                      : nullptr) {}
 
   BigNum ModExp(const BigNum& exp) const final {
-    return GetFixedBase().ModExp(exp, GetModulus());
+    if (mont_ctx_ == nullptr) {
+      return GetFixedBase().ModExp(exp, GetModulus());
+    }
+    return mont_ctx_->ModExp(GetFixedBase(), exp);
   }
+
+ private:
+  // Caches the Montgomery setup for the modulus across exponentiations. Null
+  // if the modulus is even, as Montgomery multiplication needs an odd one.
+  std::unique_ptr<MontContext> mont_ctx_;
 };
 
 // Uses the 2^k-ary technique proposed in
@@ -91,13 +106,13 @@ class TwoKAryFixedBaseExpImpl : public FixedBaseExpImplBase {
       : FixedBaseExpImplBase(fixed_base, modulus),
         ctx_(ctx),
         mont_ctx_(new MontContext(ctx, modulus)),
-        cache_() {
-    cache_.push_back(mont_ctx_->CreateMontBigNum(ctx_->CreateBigNum(1)));
+        one_(mont_ctx_->CreateMontBigNum(ctx_->CreateBigNum(1))),
+        cache_(kCacheSize, mont_ctx_->GetLimbWidth()) {
     MontBigNum g = mont_ctx_->CreateMontBigNum(GetFixedBase());
-    cache_.push_back(g);
-    int16_t max_exp = 256;
-    for (int i = 0; i < max_exp; ++i) {
-      cache_.push_back(cache_.back() * g);
+    MontBigNum power = one_;
+    for (size_t i = 0; i < kCacheSize; ++i) {
+      mont_ctx_->StoreLimbs(power, cache_[i]);
+      power *= g;
     }
   }
 
@@ -111,27 +126,42 @@ class TwoKAryFixedBaseExpImpl : public FixedBaseExpImplBase {
   // it to a short by shifting and adding is not faster than using a single
   // byte.
   BigNum ModExp(const BigNum& exp) const final {
-    MontBigNum z = cache_[0];  // Copying 1 is faster than creating it.
+    MontBigNum z = one_;  // Copying 1 is faster than creating it.
+    // Holds the current table entry; its memory is reused by every load. A
+    // load costs about a third of a multiplication at 3072 bits, i.e. about 4%
+    // of each window step, which the denser table makes up for.
+    MontBigNum entry = one_;
     std::string values = exp.ToBytes();
     for (auto it = values.cbegin(); it != values.cend(); ++it) {
       for (int j = 0; j < 8; ++j) {
         z *= z;
       }
-      z *= cache_[static_cast<int16_t>(*it)];
+      mont_ctx_->LoadLimbs(cache_[static_cast<uint8_t>(*it)], &entry);
+      z *= entry;
     }
     return z.ToBigNum();
   }
 
  private:
+  // One entry per value of an exponent byte.
+  static constexpr size_t kCacheSize = 256;
+
   Context* ctx_;
   std::unique_ptr<MontContext> mont_ctx_;
-  std::vector<MontBigNum> cache_;
+  const MontBigNum one_;
+  // fixed_base^i in Montgomery form at row i, in a single flat allocation.
+  LimbTable cache_;
 };
 
+constexpr size_t TwoKAryFixedBaseExpImpl::kCacheSize;
+
 }  // namespace internal
 
-FixedBaseExp::FixedBaseExp(internal::FixedBaseExpImplBase* impl)
-    : impl_(std::unique_ptr<internal::FixedBaseExpImplBase>(impl)) {}
+FixedBaseExp::FixedBaseExp(
+    internal::FixedBaseExpImplBase* impl,
+    std::unique_ptr<internal::MultiBufferExp> multi_buffer)
+    : impl_(std::unique_ptr<internal::FixedBaseExpImplBase>(impl)),
+      multi_buffer_(std::move(multi_buffer)) {}
 
 FixedBaseExp::~FixedBaseExp() = default;
 
@@ -141,14 +171,44 @@ StatusOr<BigNum> FixedBaseExp::ModExp(const BigNum& exp) const {
   return impl_->ModExp(exp);
 }
 
+StatusOr<std::vector<BigNum>> FixedBaseExp::ModExpBatch(
+    const std::vector<BigNum>& exps) const {
+  for (const BigNum& exp : exps) {
+    RET_INVALID_ARG_CHECK(exp.IsNonNegative())
+        << "FixedBaseExp::ModExpBatch : Negative exponents not supported.";
+  }
+  std::vector<BigNum> results;
+  results.reserve(exps.size());
+  size_t i = 0;
+  if (multi_buffer_ != nullptr) {
+    for (; i + internal::MultiBufferExp::kLanes <= exps.size();
+         i += internal::MultiBufferExp::kLanes) {
+      for (BigNum& result : multi_buffer_->ModExp(&exps[i])) {
+        results.push_back(std::move(result));
+      }
+    }
+  }
+  for (; i < exps.size(); ++i) {
+    results.push_back(impl_->ModExp(exps[i]));
+  }
+  return std::move(results);
+}
+
 std::unique_ptr<FixedBaseExp> FixedBaseExp::GetFixedBaseExp(
     Context* ctx, const BigNum& fixed_base, const BigNum& modulus) {
+  std::unique_ptr<internal::MultiBufferExp> multi_buffer;
+  if (FLAGS_multi_buffer_exp) {
+    multi_buffer =
+        internal::MultiBufferExp::Create(ctx, fixed_base, modulus);
+  }
   if (FLAGS_two_k_ary_exp) {
     return std::unique_ptr<FixedBaseExp>(new FixedBaseExp(
-        new internal::TwoKAryFixedBaseExpImpl(ctx, fixed_base, modulus)));
+        new internal::TwoKAryFixedBaseExpImpl(ctx, fixed_base, modulus),
+        std::move(multi_buffer)));
   } else {
-    return std::unique_ptr<FixedBaseExp>(
-        new FixedBaseExp(new internal::SimpleBaseExpImpl(fixed_base, modulus)));
+    return std::unique_ptr<FixedBaseExp>(new FixedBaseExp(
+        new internal::SimpleBaseExpImpl(ctx, fixed_base, modulus),
+        std::move(multi_buffer)));
   }
 }
 
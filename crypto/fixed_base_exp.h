@@ -20,6 +20,9 @@
 #ifndef CRYPTO_FIXED_BASE_H_
 #define CRYPTO_FIXED_BASE_H_
 
+#include <memory>
+#include <vector>
+
 #include "gflags/gflags_declare.h"
 #include "crypto/big_num.h"
 #include "crypto/context.h"
@@ -35,6 +38,7 @@ class StatusOr;
 namespace private_join_and_compute {
 namespace internal {
 class FixedBaseExpImplBase;
+class MultiBufferExp;
 }  // namespace internal
 
 class FixedBaseExp {
@@ -49,14 +53,24 @@ class FixedBaseExp {
   // Returns INVALID_ARGUMENT if the exponent is negative.
   util::StatusOr<BigNum> ModExp(const BigNum& exp) const;
 
+  // Computes fixed_base^exps[i] mod modulus for each i. On CPUs with AVX-512
+  // IFMA, eight exponentiations are evaluated per pass with multi-buffer
+  // arithmetic; leftover exponents and other CPUs use ModExp.
+  // Returns INVALID_ARGUMENT if any exponent is negative.
+  util::StatusOr<std::vector<BigNum>> ModExpBatch(
+      const std::vector<BigNum>& exps) const;
+
   static std::unique_ptr<FixedBaseExp> GetFixedBaseExp(Context* ctx,
                                                        const BigNum& fixed_base,
                                                        const BigNum& modulus);
 
  private:
-  explicit FixedBaseExp(internal::FixedBaseExpImplBase* impl);
+  FixedBaseExp(internal::FixedBaseExpImplBase* impl,
+               std::unique_ptr<internal::MultiBufferExp> multi_buffer);
 
   std::unique_ptr<internal::FixedBaseExpImplBase> impl_;
+  // Null if multi-buffer exponentiation is disabled or unsupported.
+  std::unique_ptr<internal::MultiBufferExp> multi_buffer_;
 };
 
 }  // namespace private_join_and_compute
@@ -19,9 +19,25 @@
 
 #include "glog/logging.h"
 #include "crypto/openssl.inc"
+#include "absl/base/config.h"
 
 namespace private_join_and_compute {
 
+constexpr size_t LimbTable::kCacheLineLimbs;
+
+LimbTable::LimbTable(size_t rows, size_t width)
+    : rows_(rows),
+      width_(width),
+      stride_((width + kCacheLineLimbs - 1) / kCacheLineLimbs *
+              kCacheLineLimbs),
+      storage_(rows * stride_ + kCacheLineLimbs - 1, 0) {
+  // std::vector only guarantees the alignment of uint64_t, so skip ahead to
+  // the first cache line boundary.
+  const uintptr_t line = kCacheLineLimbs * sizeof(uint64_t);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+  data_ = storage_.data() + (line - address % line) % line / sizeof(uint64_t);
+}
+
 MontBigNum::MontBigNum(const MontBigNum& other)
     : ctx_(other.ctx_),
       mont_ctx_(other.mont_ctx_),
@@ -114,6 +130,62 @@ MontBigNum MontContext::CreateMontBigNum(absl::string_view bytes) {
   return MontBigNum(ctx_, mont_ctx_.get(), bytes);
 }
 
+BigNum MontContext::ModExp(const BigNum& base, const BigNum& exponent) {
+  CHECK(exponent.IsNonNegative())
+      << "MontContext::ModExp: Cannot use a negative exponent.";
+  auto bn_ptr = BigNum::BignumPtr(CHECK_NOTNULL(BN_new()));
+  CRYPTO_CHECK(1 == BN_mod_exp_mont(bn_ptr.get(), base.GetConstBignumPtr(),
+                                    exponent.GetConstBignumPtr(),
+                                    modulus_.GetConstBignumPtr(),
+                                    ctx_->GetBnCtx(), mont_ctx_.get()));
+  return ctx_->CreateBigNum(std::move(bn_ptr));
+}
+
+size_t MontContext::GetLimbWidth() const {
+  return (BN_num_bits(modulus_.GetConstBignumPtr()) + 63) / 64;
+}
+
+// On little-endian machines a limb array is also the little-endian byte string
+// of the number, which BoringSSL reads and writes directly.
+void MontContext::StoreLimbs(const MontBigNum& mont_big_num,
+                             uint64_t* out) const {
+  CHECK_EQ(mont_big_num.mont_ctx_, mont_ctx_.get());
+  const size_t width = GetLimbWidth();
+#ifdef ABSL_IS_LITTLE_ENDIAN
+  CRYPTO_CHECK(1 == BN_bn2le_padded(reinterpret_cast<uint8_t*>(out),
+                                    width * sizeof(uint64_t),
+                                    mont_big_num.bn_.get()));
+#else
+  std::vector<uint8_t> bytes(width * sizeof(uint64_t));
+  CRYPTO_CHECK(1 == BN_bn2le_padded(bytes.data(), bytes.size(),
+                                    mont_big_num.bn_.get()));
+  for (size_t i = 0; i < width; ++i) {
+    out[i] = 0;
+    for (size_t j = 0; j < sizeof(uint64_t); ++j) {
+      out[i] |= static_cast<uint64_t>(bytes[i * sizeof(uint64_t) + j])
+                << (8 * j);
+    }
+  }
+#endif
+}
+
+void MontContext::LoadLimbs(const uint64_t* limbs, MontBigNum* out) const {
+  CHECK_EQ(out->mont_ctx_, mont_ctx_.get());
+  const size_t width = GetLimbWidth();
+#ifdef ABSL_IS_LITTLE_ENDIAN
+  CRYPTO_CHECK(nullptr != BN_le2bn(reinterpret_cast<const uint8_t*>(limbs),
+                                   width * sizeof(uint64_t), out->bn_.get()));
+#else
+  std::vector<uint8_t> bytes(width * sizeof(uint64_t));
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(limbs[i / sizeof(uint64_t)] >>
+                                    (8 * (i % sizeof(uint64_t))));
+  }
+  CRYPTO_CHECK(nullptr !=
+               BN_le2bn(bytes.data(), bytes.size(), out->bn_.get()));
+#endif
+}
+
 MontContext::MontContext(Context* ctx, const BigNum& modulus)
     : modulus_(modulus),
       ctx_(ctx),
@@ -28,6 +28,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "crypto/big_num.h"
 #include "crypto/context.h"
@@ -108,6 +109,44 @@ inline MontBigNum operator*(const MontBigNum& a, const MontBigNum& b) {
   return a.Mul(b);
 }
 
+// A table of equally sized numbers stored in one contiguous buffer, each as a
+// little-endian array of 64-bit limbs. The buffer and every row start on a
+// cache line boundary, so reading a row touches the fewest cache lines and the
+// whole table is a single allocation, unlike a vector of MontBigNums whose
+// limbs are each separately allocated on the heap.
+class LimbTable {
+ public:
+  static constexpr size_t kCacheLineLimbs = 8;
+
+  // Creates a zero-filled table with the given number of rows, each holding
+  // width limbs.
+  LimbTable(size_t rows, size_t width);
+
+  // LimbTable is movable but not copyable.
+  LimbTable(const LimbTable&) = delete;
+  LimbTable& operator=(const LimbTable&) = delete;
+  LimbTable(LimbTable&&) = default;
+  LimbTable& operator=(LimbTable&&) = default;
+
+  uint64_t* operator[](size_t row) { return data_ + row * stride_; }
+  const uint64_t* operator[](size_t row) const {
+    return data_ + row * stride_;
+  }
+
+  size_t rows() const { return rows_; }
+  size_t width() const { return width_; }
+
+ private:
+  size_t rows_;
+  size_t width_;
+  // The distance between consecutive rows: width rounded up to a whole number
+  // of cache lines.
+  size_t stride_;
+  std::vector<uint64_t> storage_;
+  // The first cache line aligned limb of storage_.
+  uint64_t* data_;
+};
+
 // Factory class for MontBigNum having the BN_MONT_CTX that is used to convert
 // BigNums into their Montgomery forms based on a fixed modulus.
 class MontContext {
@@ -127,6 +166,27 @@ class MontContext {
   // current MontContext, as long as their moduli are equal.
   MontBigNum CreateMontBigNum(absl::string_view bytes);
 
+  // Computes base^exponent mod modulus, reusing the Montgomery setup of this
+  // MontContext instead of deriving it from the modulus on every call as
+  // BigNum::ModExp does. The multiplications themselves run on BoringSSL's
+  // Montgomery code, which already selects MULX/ADX kernels at runtime.
+  // Fails if exponent is negative.
+  BigNum ModExp(const BigNum& base, const BigNum& exponent);
+
+  // Returns the number of 64-bit limbs needed to store any MontBigNum created
+  // by this MontContext, i.e. the width of a LimbTable holding them.
+  size_t GetLimbWidth() const;
+
+  // Writes mont_big_num, still in Montgomery form, into the GetLimbWidth()
+  // limbs at out.
+  // Fails if mont_big_num is not created with this MontContext.
+  void StoreLimbs(const MontBigNum& mont_big_num, uint64_t* out) const;
+
+  // Sets out to the Montgomery form number stored at limbs by StoreLimbs,
+  // reusing the memory of out.
+  // Fails if out is not created with this MontContext.
+  void LoadLimbs(const uint64_t* limbs, MontBigNum* out) const;
+
   // Creates MontContext based on the given modulus. Every operation on the
   // created MontBigNums using this MontContext will be done with this modulus.
   MontContext(Context* ctx, const BigNum& modulus);
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crypto/multi_buffer_exp.h"
+
+#include <algorithm>
+#include <string>
+
+#include "glog/logging.h"
+#include "crypto/openssl.inc"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PJC_HAVE_IFMA_KERNEL 1
+#endif
+
+namespace private_join_and_compute {
+namespace internal {
+namespace {
+
+constexpr int kLimbBits = 52;
+constexpr uint64_t kLimbMask = (uint64_t{1} << kLimbBits) - 1;
+constexpr int kWindowBits = 4;
+constexpr size_t kWindowSize = 1 << kWindowBits;
+
+// Writes num into num_limbs limbs of kLimbBits bits each, least significant
+// first, placing limb i at out[i * stride].
+void ToLimbs(const BigNum& num, size_t num_limbs, size_t stride,
+             uint64_t* out) {
+  CHECK_LE(static_cast<size_t>(BN_num_bits(num.GetConstBignumPtr())),
+           num_limbs * kLimbBits);
+  std::string bytes = num.ToBytes();
+  for (size_t i = 0; i < num_limbs; ++i) {
+    out[i * stride] = 0;
+  }
+  for (size_t bit = 0; bit < bytes.size() * 8; bit += 8) {
+    uint64_t byte = static_cast<uint8_t>(bytes[bytes.size() - 1 - bit / 8]);
+    size_t limb = bit / kLimbBits;
+    size_t shift = bit % kLimbBits;
+    if (limb >= num_limbs) {
+      break;  // Only zero bits are left.
+    }
+    out[limb * stride] |= (byte << shift) & kLimbMask;
+    if (shift + 8 > kLimbBits && limb + 1 < num_limbs) {
+      out[(limb + 1) * stride] |= byte >> (kLimbBits - shift);
+    }
+  }
+}
+
+// Returns the number held in num_limbs normalized kLimbBits-bit limbs, with
+// limb i at limbs[i * stride].
+BigNum FromLimbs(Context* ctx, const uint64_t* limbs, size_t num_limbs,
+                 size_t stride) {
+  std::string bytes((num_limbs * kLimbBits + 7) / 8, '\0');
+  for (size_t bit = 0; bit < bytes.size() * 8; bit += 8) {
+    size_t limb = bit / kLimbBits;
+    size_t shift = bit % kLimbBits;
+    uint64_t byte = limbs[limb * stride] >> shift;
+    if (shift + 8 > kLimbBits && limb + 1 < num_limbs) {
+      byte |= limbs[(limb + 1) * stride] << (kLimbBits - shift);
+    }
+    bytes[bytes.size() - 1 - bit / 8] = static_cast<char>(byte);
+  }
+  return ctx->CreateBigNum(bytes);
+}
+
+// Returns the window-th kWindowBits-bit window of the exponent, counting from
+// the least significant bits.
+int GetWindow(const std::string& exp_bytes, size_t window) {
+  size_t byte = window * kWindowBits / 8;
+  if (byte >= exp_bytes.size()) {
+    return 0;
+  }
+  uint8_t value = static_cast<uint8_t>(exp_bytes[exp_bytes.size() - 1 - byte]);
+  return (value >> (window * kWindowBits % 8)) & (kWindowSize - 1);
+}
+
+#ifdef PJC_HAVE_IFMA_KERNEL
+
+bool CpuSupportsIfma() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx512ifma");
+}
+
+// Almost Montgomery multiplication of the kLanes numbers in a and b, each held
+// in n limbs with lane l of limb j at index j * kLanes + l: computes
+// a * b / 2^(52 * n) mod m, up to an extra multiple of m, as the normalized
+// n-limb out. Inputs must be normalized and below 2m, and 4m must be below
+// 2^(52 * n); the output then satisfies the same bounds. t is n vectors of
+// scratch; out may alias a or b.
+__attribute__((target("avx512f,avx512ifma"))) void AlmostMontMul(
+    const uint64_t* a, const uint64_t* b, const uint64_t* m, uint64_t n0,
+    size_t n, uint64_t* t, uint64_t* out) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i n0_vec = _mm512_set1_epi64(n0);
+  for (size_t j = 0; j < n; ++j) {
+    _mm512_storeu_si512(t + j * MultiBufferExp::kLanes, zero);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    const __m512i b_i = _mm512_loadu_si512(b + i * MultiBufferExp::kLanes);
+    // Choose u so that t + a * b_i + m * u is divisible by 2^52.
+    __m512i t_0 = _mm512_loadu_si512(t);
+    const __m512i a_0 = _mm512_loadu_si512(a);
+    const __m512i m_0 = _mm512_set1_epi64(m[0]);
+    t_0 = _mm512_madd52lo_epu64(t_0, a_0, b_i);
+    const __m512i u = _mm512_madd52lo_epu64(zero, t_0, n0_vec);
+    t_0 = _mm512_madd52lo_epu64(t_0, m_0, u);
+    const __m512i carry = _mm512_srli_epi64(t_0, kLimbBits);
+
+    // Add the products and shift down by one limb in the same pass: the low
+    // halves of the products at limb j + 1 and the high halves of those at
+    // limb j all land in limb j.
+    __m512i a_j = a_0;
+    __m512i m_j = m_0;
+    for (size_t j = 0; j + 1 < n; ++j) {
+      const __m512i a_next =
+          _mm512_loadu_si512(a + (j + 1) * MultiBufferExp::kLanes);
+      const __m512i m_next = _mm512_set1_epi64(m[j + 1]);
+      __m512i x = _mm512_loadu_si512(t + (j + 1) * MultiBufferExp::kLanes);
+      x = _mm512_madd52lo_epu64(x, a_next, b_i);
+      x = _mm512_madd52lo_epu64(x, m_next, u);
+      x = _mm512_madd52hi_epu64(x, a_j, b_i);
+      x = _mm512_madd52hi_epu64(x, m_j, u);
+      _mm512_storeu_si512(t + j * MultiBufferExp::kLanes, x);
+      a_j = a_next;
+      m_j = m_next;
+    }
+    __m512i top = _mm512_madd52hi_epu64(zero, a_j, b_i);
+    top = _mm512_madd52hi_epu64(top, m_j, u);
+    _mm512_storeu_si512(t + (n - 1) * MultiBufferExp::kLanes, top);
+    _mm512_storeu_si512(t, _mm512_add_epi64(_mm512_loadu_si512(t), carry));
+  }
+
+  // Each limb accumulated at most 4n values below 2^52, which fits in 64
+  // bits; propagate the excess into the next limb.
+  const __m512i mask = _mm512_set1_epi64(kLimbMask);
+  __m512i carry = zero;
+  for (size_t j = 0; j < n; ++j) {
+    __m512i x = _mm512_add_epi64(
+        _mm512_loadu_si512(t + j * MultiBufferExp::kLanes), carry);
+    carry = _mm512_srli_epi64(x, kLimbBits);
+    _mm512_storeu_si512(out + j * MultiBufferExp::kLanes,
+                        _mm512_and_si512(x, mask));
+  }
+}
+
+// Gathers row indices[l] of table into lane l of the n-limb out.
+__attribute__((target("avx512f"))) void Gather(const LimbTable& table,
+                                               const int64_t* indices,
+                                               size_t n, uint64_t* out) {
+  const int64_t stride = table[1] - table[0];
+  int64_t row_offsets[MultiBufferExp::kLanes];
+  for (int l = 0; l < MultiBufferExp::kLanes; ++l) {
+    row_offsets[l] = indices[l] * stride;
+  }
+  const __m512i offsets = _mm512_loadu_si512(row_offsets);
+  for (size_t j = 0; j < n; ++j) {
+    __m512i limbs = _mm512_i64gather_epi64(
+        _mm512_add_epi64(offsets, _mm512_set1_epi64(j)), table[0], 8);
+    _mm512_storeu_si512(out + j * MultiBufferExp::kLanes, limbs);
+  }
+}
+
+#else
+
+bool CpuSupportsIfma() { return false; }
+
+void AlmostMontMul(const uint64_t* a, const uint64_t* b, const uint64_t* m,
+                   uint64_t n0, size_t n, uint64_t* t, uint64_t* out) {
+  LOG(FATAL) << "AVX-512 IFMA is not supported on this platform.";
+}
+
+void Gather(const LimbTable& table, const int64_t* indices, size_t n,
+            uint64_t* out) {
+  LOG(FATAL) << "AVX-512 IFMA is not supported on this platform.";
+}
+
+#endif  // PJC_HAVE_IFMA_KERNEL
+
+}  // namespace
+
+constexpr int MultiBufferExp::kLanes;
+
+std::unique_ptr<MultiBufferExp> MultiBufferExp::Create(
+    Context* ctx, const BigNum& fixed_base, const BigNum& modulus) {
+  if (!CpuSupportsIfma() || !modulus.IsBitSet(0)) {
+    return nullptr;
+  }
+  return std::unique_ptr<MultiBufferExp>(
+      new MultiBufferExp(ctx, fixed_base, modulus));
+}
+
+MultiBufferExp::MultiBufferExp(Context* ctx, const BigNum& fixed_base,
+                               const BigNum& modulus)
+    : ctx_(ctx),
+      modulus_(modulus),
+      num_limbs_(
+          (BN_num_bits(modulus.GetConstBignumPtr()) + 2 + kLimbBits - 1) /
+          kLimbBits),
+      modulus_limbs_(num_limbs_),
+      table_(kWindowSize, num_limbs_) {
+  ToLimbs(modulus_, num_limbs_, 1, modulus_limbs_.data());
+  // Newton's iteration doubles the number of correct low bits of the inverse
+  // each step, and an odd number is its own inverse modulo 2^3.
+  uint64_t inverse = modulus_limbs_[0];
+  for (int i = 0; i < 5; ++i) {
+    inverse *= 2 - modulus_limbs_[0] * inverse;
+  }
+  n0_ = (0 - inverse) & kLimbMask;
+
+  BigNum power = ctx_->One();
+  BigNum base = fixed_base.Mod(modulus_);
+  for (size_t i = 0; i < kWindowSize; ++i) {
+    ToLimbs(power.Lshift(kLimbBits * num_limbs_).Mod(modulus_), num_limbs_, 1,
+            table_[i]);
+    power = power.ModMul(base, modulus_);
+  }
+}
+
+std::vector<BigNum> MultiBufferExp::ModExp(const BigNum* exps) const {
+  const size_t n = num_limbs_;
+  std::vector<std::string> exp_bytes;
+  size_t num_windows = 1;
+  for (int l = 0; l < kLanes; ++l) {
+    CHECK(exps[l].IsNonNegative());
+    exp_bytes.push_back(exps[l].ToBytes());
+    num_windows = std::max(
+        num_windows, (exp_bytes.back().size() * 8 + kWindowBits - 1) /
+                         kWindowBits);
+  }
+
+  // Holds z, the running product, followed by the multiplication scratch.
+  LimbTable buffer(2, n * kLanes);
+  uint64_t* z = buffer[0];
+  uint64_t* scratch = buffer[1];
+  LimbTable entry(1, n * kLanes);
+  int64_t indices[kLanes];
+
+  // Left-to-right fixed-window exponentiation, all lanes in lockstep. Lanes
+  // with shorter exponents start with zero windows, which multiply by one.
+  for (size_t w = num_windows; w-- > 0;) {
+    for (int l = 0; l < kLanes; ++l) {
+      indices[l] = GetWindow(exp_bytes[l], w);
+    }
+    if (w + 1 == num_windows) {
+      Gather(table_, indices, n, z);
+      continue;
+    }
+    for (int k = 0; k < kWindowBits; ++k) {
+      AlmostMontMul(z, z, modulus_limbs_.data(), n0_, n, scratch, z);
+    }
+    Gather(table_, indices, n, entry[0]);
+    AlmostMontMul(z, entry[0], modulus_limbs_.data(), n0_, n, scratch, z);
+  }
+
+  // Multiplying by 1 leaves Montgomery form, giving a value of at most the
+  // modulus in each lane.
+  std::vector<uint64_t> one(n * kLanes, 0);
+  std::fill(one.begin(), one.begin() + kLanes, 1);
+  AlmostMontMul(z, one.data(), modulus_limbs_.data(), n0_, n, scratch, z);
+
+  std::vector<BigNum> results;
+  for (int l = 0; l < kLanes; ++l) {
+    results.push_back(FromLimbs(ctx_, z + l, n, kLanes).Mod(modulus_));
+  }
+  return results;
+}
+
+}  // namespace internal
+}  // namespace private_join_and_compute
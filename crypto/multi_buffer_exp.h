@@ -0,0 +1,77 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Multi-buffer modular exponentiation of a fixed base: evaluates
+// MultiBufferExp::kLanes exponentiations at once, one per 64-bit lane of
+// AVX-512 registers, using the 52-bit multiply-accumulate instructions of
+// AVX-512 IFMA. This follows the approach of Drucker and Gueron, "Fast
+// modular squaring with AVX512IFMA" (2018), also used by OpenSSL's RSAZ code.
+//
+// Internal to FixedBaseExp, which falls back to its scalar implementations on
+// CPUs without AVX-512 IFMA.
+
+#ifndef CRYPTO_MULTI_BUFFER_EXP_H_
+#define CRYPTO_MULTI_BUFFER_EXP_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "crypto/big_num.h"
+#include "crypto/context.h"
+#include "crypto/mont_mul.h"
+
+namespace private_join_and_compute {
+namespace internal {
+
+class MultiBufferExp {
+ public:
+  static constexpr int kLanes = 8;
+
+  // Returns a MultiBufferExp computing fixed_base^exp mod modulus, or null if
+  // the CPU does not support AVX-512 IFMA or the modulus is even.
+  static std::unique_ptr<MultiBufferExp> Create(Context* ctx,
+                                                const BigNum& fixed_base,
+                                                const BigNum& modulus);
+
+  // MultiBufferExp is neither copyable nor movable.
+  MultiBufferExp(const MultiBufferExp&) = delete;
+  MultiBufferExp& operator=(const MultiBufferExp&) = delete;
+
+  // Returns fixed_base^exps[i] mod modulus for each of the kLanes non-negative
+  // exponents starting at exps.
+  std::vector<BigNum> ModExp(const BigNum* exps) const;
+
+ private:
+  MultiBufferExp(Context* ctx, const BigNum& fixed_base,
+                 const BigNum& modulus);
+
+  Context* const ctx_;
+  const BigNum modulus_;
+  // The number of 52-bit limbs of every operand, leaving the two spare bits
+  // that almost Montgomery multiplication needs above the modulus.
+  const size_t num_limbs_;
+  std::vector<uint64_t> modulus_limbs_;
+  // -modulus^-1 mod 2^52.
+  uint64_t n0_;
+  // fixed_base^i * 2^(52 * num_limbs_) mod modulus in 52-bit limbs at row i,
+  // for every value i of an exponent window.
+  LimbTable table_;
+};
+
+}  // namespace internal
+}  // namespace private_join_and_compute
+
+#endif  // CRYPTO_MULTI_BUFFER_EXP_H_
@@ -16,6 +16,7 @@
 #include "crypto/paillier.h"
 
 #include <stddef.h>
+#include <array>
 #include <memory>
 #include <utility>
 
@@ -27,57 +28,22 @@
 #include "crypto/two_modulus_crt.h"
 #include "util/status.inc"
 #include "util/status_macros.h"
-#include "absl/container/node_hash_map.h"
+#include "absl/utility/utility.h"
 
 DEFINE_int32(generator_try_count, 1000,
              "The number of times to iteratively try to find a generator for a "
              "safe prime starting from the candidate, 2.");
+DEFINE_int32(paillier_short_randomness_security, 0,
+             "If positive, the security parameter lambda for drawing the "
+             "Paillier encryption randomness from [1, 2^(2 * lambda)) instead "
+             "of the full range, as suggested by Damgaard-Jurik-Nielsen. This "
+             "shortens the fixed-base exponentiation dominating encryption. "
+             "0 disables short randomness.");
 
 namespace private_join_and_compute {
 
 using util::StatusOr;
 
-// A class representing a table of BigNums.
-// The column length of the table is fixed and given in the constructor.
-// Example:
-//   // Given BigNum a;
-//   BigNumTable table(5);
-//   table.Insert(2, 3, a);
-//   BigNum b = table.Get(2, 3)  // returns the same copy of BigNum a each time
-//                               // Get is called with the same parameters.
-//
-// Note that while a two-dimensional vector can be used in place of this class,
-// this is more versatile in the case of partially filled tables.
-class BigNumTable {
- public:
-  // Creates a BigNumTable with a fixed column length.
-  explicit BigNumTable(size_t column_length)
-      : column_length_(column_length), table_() {}
-
-  // Inserts a copy of num into x, y cell of the table.
-  void Insert(int x, int y, const BigNum& num) {
-    CHECK_LT(y, column_length_);
-    table_.insert(std::make_pair(x * column_length_ + y, num));
-  }
-
-  // Returns a reference to the BigNum at x, y cell.
-  // Note that this object must outlive the scope of whoever called this
-  // function so that the returned reference stays valid.
-  const BigNum& Get(int x, int y) const {
-    CHECK_LT(y, column_length_);
-    auto iter = table_.find(x * column_length_ + y);
-    if (iter == table_.end()) {
-      LOG(FATAL) << "The element at x = " << x << " and y = " << y
-                 << " does not exist";
-    }
-    return iter->second;
-  }
-
- private:
-  const size_t column_length_;
-  absl::node_hash_map<int, BigNum> table_;
-};
-
 namespace {
 
 // Returns a BigNum, g, that is a generator for the Zp*.
@@ -97,6 +63,20 @@ BigNum GetGeneratorForSafePrime(Context* ctx, const BigNum& p) {
              << " generator_try_count: " << FLAGS_generator_try_count;
 }
 
+// Returns the exclusive upper bound of the randomness used as the exponent of
+// the fixed generator when encrypting: 2^(2 * lambda) if short randomness is
+// enabled and that is less than default_bound, default_bound otherwise.
+BigNum GetRandomnessBound(Context* ctx, const BigNum& default_bound) {
+  if (FLAGS_paillier_short_randomness_security > 0) {
+    BigNum short_bound =
+        ctx->One().Lshift(2 * FLAGS_paillier_short_randomness_security);
+    if (short_bound < default_bound) {
+      return short_bound;
+    }
+  }
+  return default_bound;
+}
+
 // Returns a BigNum, g, that is a generator for Zn*, where n is the product
 // of 2 safe primes.
 BigNum GetGeneratorForSafeModulus(Context* ctx, const BigNum& n) {
@@ -107,9 +87,35 @@ BigNum GetGeneratorForSafeModulus(Context* ctx, const BigNum& n) {
   return n - x.ModSqr(n);
 }
 
-// Returns a BigNum, g, that is a generator for Zp^t* for any t > 1.
-BigNum GetGeneratorOfPrimePowersFromSafePrime(Context* ctx, const BigNum& p) {
-  BigNum g = GetGeneratorForSafePrime(ctx, p);
+// Returns a BigNum, g, that is a quadratic non-residue mod p for any odd prime
+// p. Unlike GetGeneratorForSafePrime, this does not need the factorization of
+// p - 1, so g is not necessarily a generator of Zp*. Its order is however
+// divisible by the largest power of 2 dividing p - 1, and is (p - 1) / t for a
+// small t with overwhelming probability when p is a random prime. Since the
+// n^s-th powers used for the Damgaard-Jurik randomness only live in the order
+// p - 1 component of Zp^(s+1)*, which is independent of the message, this
+// large subgroup is sufficient.
+BigNum GetNonResidueForPrime(Context* ctx, const BigNum& p) {
+  BigNum p_minus_one_over_two = (p - ctx->One()) / ctx->Two();
+  BigNum g = ctx->CreateBigNum(2);
+  for (int i = 0; i < FLAGS_generator_try_count; i++) {
+    if (g.ModExp(p_minus_one_over_two, p).IsOne()) {
+      g = g + ctx->One();
+    } else {
+      return g;
+    }
+  }
+  LOG(FATAL) << "Either try_count is insufficient or p is not a prime."
+             << " generator_try_count: " << FLAGS_generator_try_count;
+}
+
+// Returns a BigNum, g, that is a generator for Zp^t* for any t > 1 if p is a
+// safe prime, or an element of large order in Zp^t* otherwise.
+BigNum GetGeneratorOfPrimePowers(Context* ctx, const BigNum& p,
+                                 PaillierPrimeType prime_type) {
+  BigNum g = prime_type == PaillierPrimeType::kSafePrimes
+                 ? GetGeneratorForSafePrime(ctx, p)
+                 : GetNonResidueForPrime(ctx, p);
   if (g.ModExp(p - ctx->One(), p * p).IsOne()) {
     return g + p;
   }
@@ -119,7 +125,7 @@ BigNum GetGeneratorOfPrimePowersFromSafePrime(Context* ctx, const BigNum& p) {
 // Returns a vector of num^i for i in [0, s + 1].
 std::vector<BigNum> GetPowers(Context* ctx, const BigNum& num, int s) {
   std::vector<BigNum> powers;
-  powers.push_back(ctx->CreateBigNum(1));
+  powers.push_back(ctx->One());
   for (int i = 1; i <= s + 1; i++) {
     powers.push_back(powers.back().Mul(num));
   }
@@ -130,18 +136,25 @@ std::vector<BigNum> GetPowers(Context* ctx, const BigNum& num, int s) {
 std::vector<BigNum> GetPrecomp(Context* ctx, const BigNum& num,
                           const BigNum& modulus, int s) {
   std::vector<BigNum> precomp;
-  precomp.push_back(ctx->CreateBigNum(1));
+  precomp.push_back(ctx->One());
   for (int i = 1; i <= s; i++) {
-    BigNum i_inv = ctx->CreateBigNum(i).ModInverse(modulus);
+    BigNum i_inv = ctx->CreatePublicBigNum(i).ModInverse(modulus);
     BigNum i_inv_n = i_inv.ModMul(num, modulus);
     precomp.push_back(precomp.back().ModMul(i_inv_n, modulus));
   }
   return precomp;
 }
 
-// Returns a vector of (1 / (k!)) * n^(k - 1) mod p^j for 2 <= k <= j <= s.
-// Reuses the values from GetPrecomp function output, precomp.
-std::unique_ptr<BigNumTable> GetDecryptPrecomp(
+// The decryption tables below stay vectors of BigNums rather than LimbTables:
+// they hold at most (s + 1)^2 entries, which stay in the cache after the first
+// decryption, and their entries feed plain BigNum products, so a limb layout
+// would only add a load per use without saving any cache misses.
+//
+// Returns a row-major table of (1 / (k!)) * n^(k - 1) mod p^j for
+// 2 <= k <= j <= s, with (s + 1) * (s + 1) entries and the value for k, j at
+// index k * (s + 1) + j. Cells outside of 2 <= k <= j <= s are zero. Reuses the
+// values from GetPrecomp function output, precomp.
+std::vector<BigNum> GetDecryptPrecomp(
     Context* ctx, const std::vector<BigNum>& precomp,
     const std::vector<BigNum>& powers, int s) {
   // The first index is k and the second one is j from the Theorem 1 algorithm
@@ -155,12 +168,14 @@ std::unique_ptr<BigNumTable> GetDecryptPrecomp(
   //     ---|
   //      --|
   //       -+
-  std::unique_ptr<BigNumTable> precomp_table(new BigNumTable(s + 1));
+  const int row_length = s + 1;
+  std::vector<BigNum> precomp_table(row_length * row_length, ctx->Zero());
   for (int k = 2; k <= s; k++) {
-    BigNum k_inverse = ctx->CreateBigNum(k).ModInverse(powers[s]);
-    precomp_table->Insert(k, s, k_inverse.ModMul(precomp[k - 1], powers[s]));
+    BigNum* row = &precomp_table[k * row_length];
+    BigNum k_inverse = ctx->CreatePublicBigNum(k).ModInverse(powers[s]);
+    row[s] = k_inverse.ModMul(precomp[k - 1], powers[s]);
     for (int j = s - 1; j >= k; j--) {
-      precomp_table->Insert(k, j, precomp_table->Get(k, j + 1).Mod(powers[j]));
+      row[j] = row[j + 1].Mod(powers[j]);
     }
   }
   return precomp_table;
@@ -176,21 +191,256 @@ BigNum ComputeByBinomialExpansion(Context* ctx,
   // cryptosystem paper.
   BigNum c = ctx->CreateBigNum(1);
   BigNum tmp = ctx->CreateBigNum(1);
+  BigNum term = ctx->CreateBigNum(0);
   const int s = precomp.size() - 1;
-  BigNum reduced_message = message.Mod(powers[s]);
+  // The factor m - j + 1, starting from m for j = 1.
+  BigNum factor = message.Mod(powers[s]);
   for (int j = 1; j <= s; j++) {
-    const BigNum& j_bn = ctx->CreateBigNum(j);
-    if (reduced_message < j_bn) {
+    if (factor.IsZero() || !factor.IsNonNegative()) {
       break;
     }
-    tmp = tmp.ModMul(reduced_message - j_bn + ctx->One(), powers[s - j + 1]);
-    c = c + tmp.ModMul(precomp[j], powers[s + 1]);
+    tmp.ModMulInPlace(factor, powers[s - j + 1]);
+    tmp.ModMulInto(precomp[j], powers[s + 1], &term);
+    c.AddInPlace(term);
+    factor.SubWordInPlace(1);
+  }
+  return c;
+}
+
+// Same as above for a message that fits in 64 bits, which must be smaller than
+// powers[s]. The message needs no reduction and is compared against j as an
+// integer, so the only BigNums created are the factors (m - j + 1).
+template <typename Precomp, typename Powers>
+BigNum ComputeSmallByBinomialExpansion(Context* ctx, const Precomp& precomp,
+                                       const Powers& powers, int s,
+                                       uint64_t message) {
+  if (message == 0) {
+    return ctx->One();
+  }
+  BigNum tmp = ctx->CreateBigNum(message);
+  BigNum c = tmp.ModMul(precomp[1], powers[s + 1]);
+  c.AddWordInPlace(1);
+  if (s == 1 || message == 1) {
+    return c;
+  }
+  BigNum factor = ctx->CreateBigNum(message - 1);
+  BigNum term = ctx->CreateBigNum(0);
+  for (int j = 2; j <= s && message >= static_cast<uint64_t>(j); j++) {
+    tmp.ModMulInPlace(factor, powers[s - j + 1]);
+    tmp.ModMulInto(precomp[j], powers[s + 1], &term);
+    c.AddInPlace(term);
+    factor.SubWordInPlace(1);
   }
   return c;
 }
 
+template <size_t N, size_t... I>
+std::array<BigNum, N> ToArrayImpl(std::vector<BigNum>* v,
+                                  absl::index_sequence<I...>) {
+  return {{std::move((*v)[I])...}};
+}
+
+// Moves the N elements of v into a std::array.
+template <size_t N>
+std::array<BigNum, N> ToArray(std::vector<BigNum> v) {
+  CHECK_EQ(v.size(), N);
+  return ToArrayImpl<N>(&v, absl::make_index_sequence<N>());
+}
+
 }  // namespace
 
+namespace internal {
+
+// The parts of the Damgaard-Jurik cryptosystem that depend on s: computing
+// (1+n)^m by binomial expansion when encrypting, and the loop of the Theorem 1
+// decryption algorithm. All computations are done modulo powers of a base,
+// which is n for PublicPaillier and one of the primes for PrimeCrypto.
+class DamgaardJurikKernel {
+ public:
+  virtual ~DamgaardJurikKernel() = default;
+
+  // Returns base^i for i in [0, s + 1].
+  virtual const BigNum& GetPower(int i) const = 0;
+
+  // Computes (1+n)^message mod base^(s+1) via binomial expansion
+  // (message=m): 1 + mn + C(m, 2)n^2 + ... + C(m, s)n^s.
+  virtual BigNum ComputeByBinomialExpansion(const BigNum& message) const = 0;
+
+  // Same as above for a message given as a 64-bit integer.
+  virtual BigNum ComputeByBinomialExpansion(uint64_t message) const = 0;
+
+  // Given l_u = L(c^lambda), returns m * lambda mod base^s up to a final
+  // reduction, as computed by the Theorem 1 algorithm from the
+  // Damgaard-Jurik-Nielsen paper.
+  virtual BigNum ExtractMessageTimesLambda(const BigNum& l_u) const = 0;
+};
+
+namespace {
+
+// DamgaardJurikKernel for an arbitrary s given at runtime.
+class RuntimeSKernel : public DamgaardJurikKernel {
+ public:
+  RuntimeSKernel(Context* ctx, const BigNum& base, const BigNum& n, int s)
+      : ctx_(ctx),
+        s_(s),
+        powers_(GetPowers(ctx, base, s)),
+        precomp_(GetPrecomp(ctx, n, powers_[s + 1], s)),
+        decrypt_precomp_(GetDecryptPrecomp(ctx, precomp_, powers_, s)),
+        small_messages_reduced_(powers_[s].BitLength() > 64) {}
+
+  const BigNum& GetPower(int i) const final { return powers_[i]; }
+
+  BigNum ComputeByBinomialExpansion(const BigNum& message) const final {
+    return private_join_and_compute::ComputeByBinomialExpansion(
+        ctx_, precomp_, powers_, message);
+  }
+
+  BigNum ComputeByBinomialExpansion(uint64_t message) const final {
+    if (!small_messages_reduced_) {
+      return ComputeByBinomialExpansion(ctx_->CreateBigNum(message));
+    }
+    return ComputeSmallByBinomialExpansion(ctx_, precomp_, powers_, s_,
+                                           message);
+  }
+
+  BigNum ExtractMessageTimesLambda(const BigNum& l_u) const final {
+    BigNum m_lambda = ctx_->CreateBigNum(0);
+    BigNum product = ctx_->CreateBigNum(0);
+    for (int j = 1; j <= s_; j++) {
+      BigNum t1 = l_u.Mod(powers_[j]);
+      BigNum t2 = m_lambda;
+      for (int k = 2; k <= j; k++) {
+        m_lambda.SubWordInPlace(1);
+        t2.ModMulInPlace(m_lambda, powers_[j]);
+        t2.MulInto(decrypt_precomp_[k * (s_ + 1) + j], &product);
+        t1.SubInPlace(product);
+      }
+      m_lambda = std::move(t1);
+    }
+    return m_lambda;
+  }
+
+ private:
+  Context* const ctx_;
+  const int s_;
+  const std::vector<BigNum> powers_;
+  const std::vector<BigNum> precomp_;
+  // (1 / (k!)) * n^(k - 1) mod base^j at index k * (s + 1) + j.
+  const std::vector<BigNum> decrypt_precomp_;
+  // Whether every 64-bit message is smaller than base^s.
+  const bool small_messages_reduced_;
+};
+
+// DamgaardJurikKernel specialized on s at compile time. The precomputed values
+// are kept in fixed-size arrays, the loop bounds are constants that the
+// compiler unrolls, and the j = 1 steps (which need no modular multiplication)
+// are peeled out of the loops. For S = 1 the binomial expansion reduces to
+// 1 + mn and the decryption loop to a single reduction.
+template <int S>
+class FixedSKernel : public DamgaardJurikKernel {
+ public:
+  FixedSKernel(Context* ctx, const BigNum& base, const BigNum& n)
+      : FixedSKernel(ctx, GetPowers(ctx, base, S), n) {}
+
+  const BigNum& GetPower(int i) const final { return powers_[i]; }
+
+  BigNum ComputeByBinomialExpansion(const BigNum& message) const final {
+    // C(m, 1) = m is already reduced modulo base^S.
+    BigNum tmp = message.Mod(powers_[S]);
+    if (tmp.IsZero()) {
+      return ctx_->One();
+    }
+    BigNum c = tmp.ModMul(precomp_[1], powers_[S + 1]);
+    c.AddWordInPlace(1);
+    if (S == 1) {
+      return c;
+    }
+    // The factor m - j + 1, starting from m - 1 for j = 2.
+    BigNum factor = tmp;
+    factor.SubWordInPlace(1);
+    BigNum term = ctx_->Zero();
+    for (int j = 2; j <= S; j++) {
+      if (factor.IsZero()) {
+        break;
+      }
+      tmp.ModMulInPlace(factor, powers_[S - j + 1]);
+      tmp.ModMulInto(precomp_[j], powers_[S + 1], &term);
+      c.AddInPlace(term);
+      factor.SubWordInPlace(1);
+    }
+    return c;
+  }
+
+  BigNum ComputeByBinomialExpansion(uint64_t message) const final {
+    if (!small_messages_reduced_) {
+      return ComputeByBinomialExpansion(ctx_->CreateBigNum(message));
+    }
+    return ComputeSmallByBinomialExpansion(ctx_, precomp_, powers_, S,
+                                           message);
+  }
+
+  BigNum ExtractMessageTimesLambda(const BigNum& l_u) const final {
+    BigNum m_lambda = l_u.Mod(powers_[1]);
+    BigNum product = ctx_->Zero();
+    for (int j = 2; j <= S; j++) {
+      BigNum t1 = l_u.Mod(powers_[j]);
+      BigNum t2 = m_lambda;
+      for (int k = 2; k <= j; k++) {
+        m_lambda.SubWordInPlace(1);
+        t2.ModMulInPlace(m_lambda, powers_[j]);
+        t2.MulInto(decrypt_precomp_[k * (S + 1) + j], &product);
+        t1.SubInPlace(product);
+      }
+      m_lambda = std::move(t1);
+    }
+    return m_lambda;
+  }
+
+ private:
+  FixedSKernel(Context* ctx, const std::vector<BigNum>& powers, const BigNum& n)
+      : FixedSKernel(ctx, powers, GetPrecomp(ctx, n, powers[S + 1], S)) {}
+
+  FixedSKernel(Context* ctx, const std::vector<BigNum>& powers,
+               const std::vector<BigNum>& precomp)
+      : ctx_(ctx),
+        powers_(ToArray<S + 2>(powers)),
+        precomp_(ToArray<S + 1>(precomp)),
+        decrypt_precomp_(ToArray<(S + 1) * (S + 1)>(
+            GetDecryptPrecomp(ctx, precomp, powers, S))),
+        small_messages_reduced_(powers_[S].BitLength() > 64) {}
+
+  Context* const ctx_;
+  // base^i for i in [0, S + 1].
+  const std::array<BigNum, S + 2> powers_;
+  // (1 / (i!)) * n^i mod base^(S+1) for i in [0, S].
+  const std::array<BigNum, S + 1> precomp_;
+  // (1 / (k!)) * n^(k - 1) mod base^j at index k * (S + 1) + j.
+  const std::array<BigNum, (S + 1) * (S + 1)> decrypt_precomp_;
+  // Whether every 64-bit message is smaller than base^S.
+  const bool small_messages_reduced_;
+};
+
+}  // namespace
+
+// Returns a DamgaardJurikKernel specialized at compile time for s = 1 and
+// s = 2, falling back to the generic runtime-s implementation otherwise.
+std::unique_ptr<DamgaardJurikKernel> CreateDamgaardJurikKernel(
+    Context* ctx, const BigNum& base, const BigNum& n, int s) {
+  switch (s) {
+    case 1:
+      return std::unique_ptr<DamgaardJurikKernel>(
+          new FixedSKernel<1>(ctx, base, n));
+    case 2:
+      return std::unique_ptr<DamgaardJurikKernel>(
+          new FixedSKernel<2>(ctx, base, n));
+    default:
+      return std::unique_ptr<DamgaardJurikKernel>(
+          new RuntimeSKernel(ctx, base, n, s));
+  }
+}
+
+}  // namespace internal
+
 // A helper class defining Encrypt and Decrypt for only one of the prime parts
 // of the composite number n. Computing (1+n)^m * g^r mod p^(s+1) where r is in
 // [1, p) for both p and q and then computing CRT yields a result with the same
@@ -203,38 +453,63 @@ class PrimeCrypto {
  public:
   // Creates a PrimeCrypto with the given parameter where p and other_prime is
   // either <p, q> or <q, p>.
-  PrimeCrypto(Context* ctx, const BigNum& p, const BigNum& other_prime, int s)
+  PrimeCrypto(Context* ctx, const BigNum& p, const BigNum& other_prime, int s,
+              PaillierPrimeType prime_type)
       : ctx_(ctx),
         p_(p),
         p_phi_(p - ctx->One()),
         n_(p * other_prime),
         s_(s),
-        powers_(GetPowers(ctx, p, s)),
-        precomp_(GetPrecomp(ctx, n_, powers_[s + 1], s)),
-        lambda_inv_(p_phi_.ModInverse(powers_[s_])),
-        other_prime_inv_(other_prime.ModInverse(powers_[s])),
-        decrypt_precomp_(GetDecryptPrecomp(ctx, precomp_, powers_, s)),
-        g_p_(GetGeneratorOfPrimePowersFromSafePrime(ctx, p)),
+        kernel_(internal::CreateDamgaardJurikKernel(ctx, p, n_, s)),
+        lambda_inv_(p_phi_.ModInverse(GetPToExp(s))),
+        other_prime_inv_(other_prime.ModInverse(GetPToExp(s))),
+        g_p_(GetGeneratorOfPrimePowers(ctx, p, prime_type)),
         fbe_(FixedBaseExp::GetFixedBaseExp(
-            ctx, g_p_.ModExp(n_.Exp(ctx->CreateBigNum(s)), powers_[s + 1]),
-            powers_[s + 1])) {}
+            ctx, g_p_.ModExp(n_.Exp(ctx->CreateBigNum(s)), GetPToExp(s + 1)),
+            GetPToExp(s + 1))),
+        rand_bound_(GetRandomnessBound(ctx, p)) {}
 
   // PrimeCrypto is neither copyable nor movable.
   PrimeCrypto(const PrimeCrypto&) = delete;
   PrimeCrypto& operator=(const PrimeCrypto&) = delete;
 
-  // Computes (1+n)^m * g^r mod p^(s+1) where r is in [1, p).
-  StatusOr<BigNum> Encrypt(const BigNum& m) const {
-    return EncryptWithRand(m, ctx_->GenerateRandBetween(ctx_->One(), p_));
+  // Computes (1+n)^m * g^r mod p^(s+1) where r is in [1, p), or in
+  // [1, 2^(2 * lambda)) with short randomness.
+  // The message is either a BigNum or a uint64_t.
+  template <typename Message>
+  StatusOr<BigNum> Encrypt(const Message& m) const {
+    return EncryptWithRand(m,
+                           ctx_->GenerateRandBetween(ctx_->One(), rand_bound_));
   }
 
   // Encrypts the message similar to other Encrypt method, but uses the input
   // random value. (The caller has responsibility to ensure the randomness of
   // the value.)
-  StatusOr<BigNum> EncryptWithRand(const BigNum& m, const BigNum& r) const {
-    BigNum c_p = ComputeByBinomialExpansion(ctx_, precomp_, powers_, m);
+  template <typename Message>
+  StatusOr<BigNum> EncryptWithRand(const Message& m, const BigNum& r) const {
+    BigNum c_p = kernel_->ComputeByBinomialExpansion(m);
     BigNum g_to_r = RETURN_OR_ASSIGN(fbe_->ModExp(r));
-    return c_p.ModMul(g_to_r, powers_[s_ + 1]);
+    c_p.ModMulInPlace(g_to_r, GetPToExp(s_ + 1));
+    return std::move(c_p);
+  }
+
+  // Encrypts each of the messages as Encrypt does, batching the fixed-base
+  // exponentiations.
+  template <typename Message>
+  StatusOr<std::vector<BigNum>> EncryptBatch(
+      const std::vector<Message>& messages) const {
+    std::vector<BigNum> rands;
+    rands.reserve(messages.size());
+    for (size_t i = 0; i < messages.size(); i++) {
+      rands.push_back(ctx_->GenerateRandBetween(ctx_->One(), rand_bound_));
+    }
+    std::vector<BigNum> ciphertexts =
+        RETURN_OR_ASSIGN(fbe_->ModExpBatch(rands));
+    for (size_t i = 0; i < messages.size(); i++) {
+      ciphertexts[i].ModMulInPlace(
+          kernel_->ComputeByBinomialExpansion(messages[i]), GetPToExp(s_ + 1));
+    }
+    return std::move(ciphertexts);
   }
 
   // Decrypts c for this prime part so that computing CRT with the other prime
@@ -242,32 +517,25 @@ class PrimeCrypto {
   BigNum Decrypt(const BigNum& c) const {
     // Theorem 1 algorithm from Damgaard-Jurik-Nielsen paper.
     // Cancels out the random portion and compute the L function.
-    BigNum l_u = LFunc(c.ModExp(p_phi_, powers_[s_ + 1]));
-    BigNum m_lambda = ctx_->CreateBigNum(0);
-    for (int j = 1; j <= s_; j++) {
-      BigNum t1 = l_u.Mod(powers_[j]);
-      BigNum t2 = m_lambda;
-      for (int k = 2; k <= j; k++) {
-        m_lambda = m_lambda - ctx_->One();
-        t2 = t2.ModMul(m_lambda, powers_[j]);
-        t1 = t1 - t2 * decrypt_precomp_->Get(k, j);
-      }
-      m_lambda = std::move(t1);
-    }
-    return m_lambda.ModMul(lambda_inv_, powers_[s_]);
+    BigNum l_u = LFunc(c.ModExp(p_phi_, GetPToExp(s_ + 1)));
+    BigNum m = kernel_->ExtractMessageTimesLambda(l_u);
+    m.ModMulInPlace(lambda_inv_, GetPToExp(s_));
+    return m;
   }
 
   // Returns p^i from the cache.
-  const BigNum& GetPToExp(int i) const { return powers_[i]; }
+  const BigNum& GetPToExp(int i) const { return kernel_->GetPower(i); }
 
  private:
   friend class PrimeCryptoWithRand;
   // Paillier L function modified to work on prime parts. Refer to the
   // subsection "Decryption" under Section 4.2 "Optimizations of Encryption"
   // from the Damgaard-Jurik cryptosystem paper.
-  BigNum LFunc(const BigNum& c_mod_p_to_s_plus_one) const {
-    return ((c_mod_p_to_s_plus_one - ctx_->One()) / p_)
-        .ModMul(other_prime_inv_, GetPToExp(s_));
+  BigNum LFunc(BigNum c_mod_p_to_s_plus_one) const {
+    c_mod_p_to_s_plus_one.SubWordInPlace(1);
+    BigNum l = c_mod_p_to_s_plus_one / p_;
+    l.ModMulInPlace(other_prime_inv_, GetPToExp(s_));
+    return l;
   }
 
   Context* const ctx_;
@@ -275,13 +543,13 @@ class PrimeCrypto {
   const BigNum p_phi_;
   const BigNum n_;
   const int s_;
-  const std::vector<BigNum> powers_;
-  const std::vector<BigNum> precomp_;
+  const std::unique_ptr<internal::DamgaardJurikKernel> kernel_;
   const BigNum lambda_inv_;
   const BigNum other_prime_inv_;
-  const std::unique_ptr<BigNumTable> decrypt_precomp_;
   const BigNum g_p_;
   std::unique_ptr<FixedBaseExp> fbe_;
+  // Exclusive upper bound of the random exponent r.
+  const BigNum rand_bound_;
 };
 
 // Class that wraps a PrimeCrypto, and additionally can return the random number
@@ -313,7 +581,8 @@ class PrimeCryptoWithRand {
   // Encrypts the message the same way as in PrimeCrypto, and returns the
   // random used.
   StatusOr<PaillierEncAndRand> EncryptAndGetRand(const BigNum& m) const {
-    BigNum r = ctx_->GenerateRandBetween(ctx_->One(), prime_crypto_->p_);
+    BigNum r =
+        ctx_->GenerateRandBetween(ctx_->One(), prime_crypto_->rand_bound_);
     BigNum ct = RETURN_OR_ASSIGN(EncryptWithRand(m, r));
     BigNum exp_for_report_to_r = RETURN_OR_ASSIGN(exp_for_report_->ModExp(r));
     return {{std::move(ct), std::move(exp_for_report_to_r)}};
@@ -334,13 +603,14 @@ PublicPaillier::PublicPaillier(Context* ctx, const BigNum& n, int s)
     : ctx_(ctx),
       n_(n),
       s_(s),
-      n_powers_(GetPowers(ctx, n_, s)),
-      modulus_(n_powers_.back()),
+      kernel_(internal::CreateDamgaardJurikKernel(ctx, n_, n_, s)),
+      modulus_(kernel_->GetPower(s + 1)),
       g_n_fbe_(FixedBaseExp::GetFixedBaseExp(
           ctx,
-          GetGeneratorForSafeModulus(ctx_, n).ModExp(n_powers_[s], modulus_),
+          GetGeneratorForSafeModulus(ctx_, n).ModExp(kernel_->GetPower(s),
+                                                     modulus_),
           modulus_)),
-      precomp_(GetPrecomp(ctx, n_, modulus_, s)) {}
+      rand_bound_(GetRandomnessBound(ctx, n)) {}
 
 PublicPaillier::PublicPaillier(Context* ctx, const BigNum& n)
     : PublicPaillier(ctx, n, kDefaultS) {}
@@ -351,6 +621,10 @@ BigNum PublicPaillier::Add(const BigNum& c1, const BigNum& c2) const {
   return c1.ModMul(c2, modulus_);
 }
 
+void PublicPaillier::AddInPlace(BigNum* sum, const BigNum& ciphertext) const {
+  sum->ModMulInPlace(ciphertext, modulus_);
+}
+
 BigNum PublicPaillier::Multiply(const BigNum& c, const BigNum& m) const {
   return c.ModExp(m, modulus_);
 }
@@ -362,16 +636,17 @@ BigNum PublicPaillier::LeftShift(const BigNum& c, int shift_amount) const {
 StatusOr<BigNum> PublicPaillier::Encrypt(const BigNum& m) const {
   RET_INVALID_ARG_CHECK(m.IsNonNegative())
       << "PublicPaillier::Encrypt() - Cannot encrypt negative number.";
-  RET_INVALID_ARG_CHECK(m < n_powers_[s_])
+  RET_INVALID_ARG_CHECK(m < kernel_->GetPower(s_))
       << "PublicPaillier::Encrypt() - Message not smaller than n^s.";
-  return EncryptUsingGeneratorAndRand(m, ctx_->GenerateRandLessThan(n_));
+  return EncryptUsingGeneratorAndRand(m,
+                                      ctx_->GenerateRandLessThan(rand_bound_));
 }
 
 StatusOr<BigNum> PublicPaillier::EncryptUsingGeneratorAndRand(
     const BigNum& m, const BigNum& r) const {
   RET_INVALID_ARG_CHECK(r <= n_)
       << "The given random is not less than or equal to n.";
-  BigNum c = ComputeByBinomialExpansion(ctx_, precomp_, n_powers_, m);
+  BigNum c = kernel_->ComputeByBinomialExpansion(m);
   BigNum g_n_to_r = RETURN_OR_ASSIGN(g_n_fbe_->ModExp(r));
   return c.ModMul(g_n_to_r, modulus_);
 }
@@ -381,8 +656,8 @@ StatusOr<BigNum> PublicPaillier::EncryptWithRand(const BigNum& m,
                                                  const BigNum& r) const {
   RET_INVALID_ARG_CHECK(r.Gcd(n_) == ctx_->One())
       << "The given random is not in Z*n.";
-  BigNum c = ComputeByBinomialExpansion(ctx_, precomp_, n_powers_, m);
-  return c.ModMul(r.ModExp(n_powers_[s_], modulus_), modulus_);
+  BigNum c = kernel_->ComputeByBinomialExpansion(m);
+  return c.ModMul(r.ModExp(kernel_->GetPower(s_), modulus_), modulus_);
 }
 
 StatusOr<PaillierEncAndRand> PublicPaillier::EncryptAndGetRand(
@@ -396,11 +671,15 @@ PrivatePaillier::~PrivatePaillier() = default;
 
 PrivatePaillier::PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q,
                                  int s)
+    : PrivatePaillier(ctx, p, q, s, PaillierPrimeType::kSafePrimes) {}
+
+PrivatePaillier::PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q,
+                                 int s, PaillierPrimeType prime_type)
     : ctx_(ctx),
       n_to_s_((p * q).Exp(ctx_->CreateBigNum(s))),
       n_to_s_plus_one_(n_to_s_ * p * q),
-      p_crypto_(new PrimeCrypto(ctx, p, q, s)),
-      q_crypto_(new PrimeCrypto(ctx, q, p, s)),
+      p_crypto_(new PrimeCrypto(ctx, p, q, s, prime_type)),
+      q_crypto_(new PrimeCrypto(ctx, q, p, s, prime_type)),
       two_mod_crt_encrypt_(new TwoModulusCrt(p_crypto_->GetPToExp(s + 1),
                                              q_crypto_->GetPToExp(s + 1))),
       two_mod_crt_decrypt_(new TwoModulusCrt(p_crypto_->GetPToExp(s),
@@ -416,6 +695,46 @@ StatusOr<BigNum> PrivatePaillier::Encrypt(const BigNum& m) const {
   return two_mod_crt_encrypt_->Compute(p_ct, q_ct);
 }
 
+StatusOr<std::vector<BigNum>> PrivatePaillier::EncryptBatch(
+    const std::vector<BigNum>& messages) const {
+  for (const BigNum& m : messages) {
+    RET_INVALID_ARG_CHECK(m.IsNonNegative())
+        << "PrivatePaillier::EncryptBatch() - Cannot encrypt negative number.";
+    RET_INVALID_ARG_CHECK(m < n_to_s_)
+        << "PrivatePaillier::EncryptBatch() - Message not smaller than n^s.";
+  }
+  std::vector<BigNum> p_cts =
+      RETURN_OR_ASSIGN(p_crypto_->EncryptBatch(messages));
+  std::vector<BigNum> q_cts =
+      RETURN_OR_ASSIGN(q_crypto_->EncryptBatch(messages));
+  return two_mod_crt_encrypt_->ComputeBatch(p_cts, q_cts);
+}
+
+StatusOr<BigNum> PrivatePaillier::Encrypt(uint64_t m) const {
+  RET_INVALID_ARG_CHECK(IsSmallMessageInRange(m))
+      << "PrivatePaillier::Encrypt() - Message not smaller than n^s.";
+  BigNum p_ct = RETURN_OR_ASSIGN(p_crypto_->Encrypt(m));
+  BigNum q_ct = RETURN_OR_ASSIGN(q_crypto_->Encrypt(m));
+  return two_mod_crt_encrypt_->Compute(p_ct, q_ct);
+}
+
+StatusOr<std::vector<BigNum>> PrivatePaillier::EncryptBatch(
+    const std::vector<uint64_t>& messages) const {
+  for (uint64_t m : messages) {
+    RET_INVALID_ARG_CHECK(IsSmallMessageInRange(m))
+        << "PrivatePaillier::EncryptBatch() - Message not smaller than n^s.";
+  }
+  std::vector<BigNum> p_cts =
+      RETURN_OR_ASSIGN(p_crypto_->EncryptBatch(messages));
+  std::vector<BigNum> q_cts =
+      RETURN_OR_ASSIGN(q_crypto_->EncryptBatch(messages));
+  return two_mod_crt_encrypt_->ComputeBatch(p_cts, q_cts);
+}
+
+bool PrivatePaillier::IsSmallMessageInRange(uint64_t m) const {
+  return n_to_s_.BitLength() > 64 || ctx_->CreateBigNum(m) < n_to_s_;
+}
+
 PrivatePaillier::PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q)
     : PrivatePaillier(ctx, p, q, kDefaultS) {}
 
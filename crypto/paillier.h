@@ -78,11 +78,32 @@ class PrimeCryptoWithRand;
 class FixedBaseExp;
 class TwoModulusCrt;
 
+// The largest Damgaard-Jurik s accepted from the other party. Ciphertexts and
+// exponentiations grow with n^(s+1), so larger values would only serve to
+// exhaust the receiver; s = 8 already fits plaintexts of 8 times the bits of
+// n, e.g. dozens of packed value columns.
+const int kMaxPaillierS = 8;
+
 // Forward declaration of Paillier zero knowledge proof class.
 namespace internal {
 class PaillierOrZkpe;
+// Holds the s-dependent precomputations and hot loops of the Damgaard-Jurik
+// cryptosystem, specialized at compile time for the common values of s.
+class DamgaardJurikKernel;
 }  // namespace internal
 
+// The kind of primes forming a Paillier private key.
+enum class PaillierPrimeType {
+  // p and q are safe primes, i.e. (p-1)/2 and (q-1)/2 are also prime. This
+  // lets the generators of the randomness be proven to generate the full
+  // groups, but key generation is orders of magnitude slower.
+  kSafePrimes,
+  // p and q are ordinary primes of the same bit length. The generators of the
+  // randomness are derived without relying on the structure of p-1 and q-1,
+  // and generate large subgroups with overwhelming probability.
+  kPrimes,
+};
+
 // Holds the resulting ciphertext from a Paillier encryption as well as the
 // random number used.
 struct PaillierEncAndRand {
@@ -104,8 +125,8 @@ struct PaillierEncAndRand {
 class PublicPaillier {
  public:
   // Creates a generic PublicPaillier with the public key n and s.
-  // n is a composite number equals to p * q where p and q are safe primes and
-  // private.
+  // n is a composite number equals to p * q where p and q are private primes,
+  // usually safe primes (see PaillierPrimeType).
   // n^s is the plaintext size and n^(s+1) is the ciphertext size.
   PublicPaillier(Context* ctx, const BigNum& n, int s);
 
@@ -124,6 +145,12 @@ class PublicPaillier {
   // encryption of the sum of the two plaintexts.
   BigNum Add(const BigNum& ciphertext1, const BigNum& ciphertext2) const;
 
+  // Same as Add, but accumulates the ciphertext into *sum in place.
+  //
+  // Only uses the Context of *sum, so that threads may accumulate sums created
+  // in distinct Contexts concurrently.
+  void AddInPlace(BigNum* sum, const BigNum& ciphertext) const;
+
   // Multiplies a ciphertext homomorphically such that the result is an
   // encryption of the product of the plaintext and the multiplier.
   // Note that multiplier should *not* be encrypted.
@@ -135,7 +162,8 @@ class PublicPaillier {
 
   // Encrypts the message and returns the ciphertext equivalent to:
   // (1+n)^message * g^random mod n^(s+1), where g is the generator chosen
-  // during setup.
+  // during setup. random is drawn from [0, n), or from [0, 2^(2 * lambda)) when
+  // --paillier_short_randomness_security=lambda is set.
   // Returns INVALID_ARGUMENT status when the message is < 0 or >= n^s.
   util::StatusOr<BigNum> Encrypt(const BigNum& message) const;
 
@@ -172,21 +200,22 @@ class PublicPaillier {
   // Composite BigNum of two large primes.
   const BigNum n_;
   const int s_;
-  // Vector containing the n powers upto s+1 for faster computation.
-  const std::vector<BigNum> n_powers_;
+  // Holds the n powers upto s+1 for faster computation, and the values that
+  // are computed repeatedly when encrypting arbitrary messages via computing
+  // the binomial expansion of (1+n)^message.
+  // The binomial expansion of (1+n) to some arbitrary exponent has constant
+  // factors depending on only 1, n, and s regardless of the exponent value,
+  // the kernel holds each of these fixed values for faster computation.
+  // Refer to Section 4.2 "Optimization of Encryption" from the
+  // Damgaard-Jurik-Nielsen paper for more information.
+  const std::unique_ptr<internal::DamgaardJurikKernel> kernel_;
   // n^(s+1)
   const BigNum modulus_;
   // generator of the subgroup of n^s-th residues mod n^s+1. Used for faster
   // computation of the random component r of the ciphertext.
   std::unique_ptr<FixedBaseExp> g_n_fbe_;
-  // The vector holding values that are computed repeatedly when encrypting
-  // arbitrary messages via computing the binomial expansion of (1+n)^message.
-  // The binomial expansion of (1+n) to some arbitrary exponent has constant
-  // factors depending on only 1, n, and s regardless of the exponent value,
-  // this vector holds each of these fixed values for faster computation.
-  // Refer to Section 4.2 "Optimization of Encryption" from the
-  // Damgaard-Jurik-Nielsen paper for more information.
-  const std::vector<BigNum> precomp_;
+  // Exclusive upper bound of the random exponent used by Encrypt.
+  const BigNum rand_bound_;
 };
 
 // The class defining Damgaard-Jurik cryptosystem operations that can be
@@ -211,6 +240,11 @@ class PrivatePaillier {
   // is the ciphertext size.
   PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q, int s);
 
+  // Creates a PrivatePaillier using the s value and the private key p and q,
+  // where p and q are primes of the given type.
+  PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q, int s,
+                  PaillierPrimeType prime_type);
+
   // Creates a PrivatePaillier equivalent to the original Paillier cryptosystem
   // (i.e., s = 1)
   PrivatePaillier(Context* ctx, const BigNum& p, const BigNum& q);
@@ -233,10 +267,31 @@ class PrivatePaillier {
   //    exponentiation is used rather than naively computing g^random in each
   //    time Encrypt is called, this O(logn) complexity can be further improved
   //    relatively to the used method effectiveness.
+  // 3) Optionally, with --paillier_short_randomness_security=lambda, the random
+  //    exponent is drawn from 2 * lambda bits rather than the full range of the
+  //    prime, shortening the exponentiation proportionally.
   //
   // Returns INVALID_ARGUMENT status when the message is < 0 or >= n^s.
   util::StatusOr<BigNum> Encrypt(const BigNum& message) const;
 
+  // Encrypts each of the messages as Encrypt does. The fixed-base
+  // exponentiations of all messages are batched, which lets CPUs with AVX-512
+  // IFMA compute eight of them at a time.
+  //
+  // Returns INVALID_ARGUMENT status when any message is < 0 or >= n^s.
+  util::StatusOr<std::vector<BigNum>> EncryptBatch(
+      const std::vector<BigNum>& messages) const;
+
+  // Same as the above Encrypt and EncryptBatch for messages given as 64-bit
+  // integers, which spares creating a BigNum per message. For any realistic key
+  // such messages are smaller than n^s and need no reduction, so the binomial
+  // expansion works on them as integers.
+  //
+  // Returns INVALID_ARGUMENT status when any message is >= n^s.
+  util::StatusOr<BigNum> Encrypt(uint64_t message) const;
+  util::StatusOr<std::vector<BigNum>> EncryptBatch(
+      const std::vector<uint64_t>& messages) const;
+
   // Decrypts the ciphertext and returns the message inside as a BigNum.
   // Uses the algorithm from the Theorem 1 in Damgaard-Jurik-Nielsen paper.
   // This method also benefits from computing the decryption for each safe prime
@@ -247,6 +302,9 @@ class PrivatePaillier {
 
  private:
   friend class PrivatePaillierWithRand;
+  // Returns whether the message is smaller than n^s.
+  bool IsSmallMessageInRange(uint64_t message) const;
+
   // Factory class for creating BigNums and holding the temporary values for
   // the BigNum arithmetic operations. Ownership is not taken.
   Context* const ctx_;
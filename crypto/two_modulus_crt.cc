@@ -15,18 +15,42 @@
 
 #include "crypto/two_modulus_crt.h"
 
+#include "glog/logging.h"
+
 namespace private_join_and_compute {
 
 TwoModulusCrt::TwoModulusCrt(const BigNum& coprime1, const BigNum& coprime2) :
-  crt_term1_(coprime2 * coprime2.ModInverse(coprime1)),
-  crt_term2_(coprime1 * coprime1.ModInverse(coprime2)),
+  coprime1_(coprime1),
+  coprime2_(coprime2),
+  coprime1_inv_(coprime1.ModInverse(coprime2)),
   coprime_product_(coprime1 * coprime2) {
 }
 
 BigNum TwoModulusCrt::Compute(const BigNum& solution1,
                               const BigNum& solution2) const {
-  return ((solution1 * crt_term1_) + (solution2 * crt_term2_)).Mod(
-      coprime_product_);
+  // Garner's formula only yields a result below the product if solution1 is
+  // reduced.
+  if (!solution1.IsNonNegative() || solution1 >= coprime1_) {
+    return Compute(solution1.Mod(coprime1_), solution2);
+  }
+  BigNum result = solution2.ModSub(solution1, coprime2_);
+  result.ModMulInPlace(coprime1_inv_, coprime2_);
+  result.MulInPlace(coprime1_);
+  result.AddInPlace(solution1);
+  return result;
+}
+
+std::vector<BigNum> TwoModulusCrt::ComputeBatch(
+    const std::vector<BigNum>& solutions1,
+    const std::vector<BigNum>& solutions2) const {
+  CHECK_EQ(solutions1.size(), solutions2.size())
+      << "TwoModulusCrt::ComputeBatch: solution vectors differ in size.";
+  std::vector<BigNum> results;
+  results.reserve(solutions1.size());
+  for (size_t i = 0; i < solutions1.size(); i++) {
+    results.push_back(Compute(solutions1[i], solutions2[i]));
+  }
+  return results;
 }
 
 BigNum TwoModulusCrt::GetCoprimeProduct() const { return coprime_product_; }
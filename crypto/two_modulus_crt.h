@@ -19,6 +19,8 @@
 #ifndef CRYPTO_TWO_MODULUS_CRT_H_
 #define CRYPTO_TWO_MODULUS_CRT_H_
 
+#include <vector>
+
 #include "crypto/big_num.h"
 
 namespace private_join_and_compute {
@@ -34,16 +36,29 @@ class TwoModulusCrt {
   ~TwoModulusCrt() = default;
 
   // Computes r s.t. r congruent to both solution1 mod coprime1 and
-  // solution2 mod coprime2.
+  // solution2 mod coprime2, with 0 <= r < coprime1 * coprime2.
+  //
+  // Uses Garner's formula r = s1 + coprime1 * ((s2 - s1) * coprime1^-1 mod
+  // coprime2), which costs a single multiplication modulo coprime2 plus one
+  // unreduced multiplication, instead of two product-sized multiplications and
+  // a reduction modulo the product. It is fastest when solution1 is already
+  // reduced modulo coprime1.
   BigNum Compute(const BigNum& solution1, const BigNum& solution2) const;
 
+  // Same as Compute, applied to solutions1[i] and solutions2[i] for each i.
+  // Fails if the two vectors differ in size.
+  std::vector<BigNum> ComputeBatch(const std::vector<BigNum>& solutions1,
+                                   const std::vector<BigNum>& solutions2) const;
+
   // Returns the product of the two coprime values given to the constructor as
   // input.
   BigNum GetCoprimeProduct() const;
 
  private:
-  BigNum crt_term1_;
-  BigNum crt_term2_;
+  BigNum coprime1_;
+  BigNum coprime2_;
+  // coprime1^-1 mod coprime2.
+  BigNum coprime1_inv_;
   BigNum coprime_product_;
 };
 
@@ -331,6 +331,35 @@ util::StatusOr<std::vector<std::string>> ReadServerDatasetFromFile(
 util::StatusOr<std::pair<std::vector<std::string>, std::vector<BigNum>>>
 ReadClientDatasetFromFile(absl::string_view client_data_filename,
                           Context* context) {
+  auto maybe_dataset =
+      ReadClientDatasetWithValueColumnsFromFile(client_data_filename);
+  if (!maybe_dataset.ok()) {
+    return maybe_dataset.status();
+  }
+  auto dataset = std::move(maybe_dataset.ValueOrDie());
+  if (dataset.first.empty()) {
+    return std::make_pair(std::move(dataset.first), std::vector<BigNum>());
+  }
+  if (dataset.second.size() != 1) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "ReadClientDatasetFromFile: Expected exactly 2 items per line, "
+        "but found ",
+        dataset.second.size() + 1,
+        " comma-separated items (file: ", client_data_filename, ")"));
+  }
+  std::vector<BigNum> client_associated_values;
+  client_associated_values.reserve(dataset.second[0].size());
+  for (int64_t value : dataset.second[0]) {
+    client_associated_values.push_back(context->CreateBigNum(value));
+  }
+  return std::make_pair(std::move(dataset.first),
+                        std::move(client_associated_values));
+}
+
+util::StatusOr<
+    std::pair<std::vector<std::string>, std::vector<std::vector<int64_t>>>>
+ReadClientDatasetWithValueColumnsFromFile(
+    absl::string_view client_data_filename) {
   // Open file.
   std::ifstream client_data_file;
   client_data_file.open(std::string(client_data_filename));
@@ -341,32 +370,39 @@ ReadClientDatasetFromFile(absl::string_view client_data_filename,
   }
 
   // Read each line from file (unescaping and splitting columns). Verify that
-  // each line contains two columns, and parse the second column into an
-  // associated value.
+  // each line contains an identifier and the same number of associated values
+  // as the first line, and parse each associated value.
   std::vector<std::string> client_identifiers;
-  std::vector<BigNum> client_associated_values;
+  std::vector<std::vector<int64_t>> client_associated_value_columns;
   std::string line;
   int64_t line_number = 0;
   while (getline(client_data_file, line)) {
     std::vector<std::string> columns = SplitCsvLine(line);
-    if (columns.size() != 2) {
+    if (line_number == 0 && columns.size() >= 2) {
+      client_associated_value_columns.resize(columns.size() - 1);
+    }
+    if (columns.size() < 2 ||
+        columns.size() != client_associated_value_columns.size() + 1) {
       return util::InvalidArgumentError(absl::StrCat(
-          "ReadClientDatasetFromFile: Expected exactly 2 items per line, "
-          "but line ",
-          line_number, "has ", columns.size(),
-          " comma-separated items (file: ", client_data_filename, ")"));
+          "ReadClientDatasetFromFile: Expected an identifier and ",
+          std::max<size_t>(client_associated_value_columns.size(), 1),
+          " associated value(s) per line, but line ", line_number, " has ",
+          columns.size(), " comma-separated items (file: ",
+          client_data_filename, ")"));
     }
     client_identifiers.push_back(columns[0]);
-    int64_t parsed_associated_value;
-    if (!absl::SimpleAtoi(columns[1], &parsed_associated_value) ||
-        parsed_associated_value < 0) {
-      return util::InvalidArgumentError(
-          absl::StrCat("ReadClientDatasetFromFile: could not parse a "
-                       "nonnegative associated value at line number",
-                       line_number));
+    for (size_t k = 1; k < columns.size(); k++) {
+      int64_t parsed_associated_value;
+      if (!absl::SimpleAtoi(columns[k], &parsed_associated_value) ||
+          parsed_associated_value < 0) {
+        return util::InvalidArgumentError(
+            absl::StrCat("ReadClientDatasetFromFile: could not parse a "
+                         "nonnegative associated value at line number",
+                         line_number));
+      }
+      client_associated_value_columns[k - 1].push_back(
+          parsed_associated_value);
     }
-    client_associated_values.push_back(
-        context->CreateBigNum(parsed_associated_value));
     line_number++;
   }
 
@@ -379,7 +415,7 @@ ReadClientDatasetFromFile(absl::string_view client_data_filename,
   }
 
   return std::make_pair(std::move(client_identifiers),
-                        std::move(client_associated_values));
+                        std::move(client_associated_value_columns));
 }
 
 }  // namespace private_join_and_compute
@@ -84,5 +84,16 @@ util::StatusOr<std::pair<std::vector<std::string>, std::vector<BigNum>>>
 ReadClientDatasetFromFile(absl::string_view client_data_filename,
                           Context* context);
 
+// Read Client Dataset with one or more associated value columns from the
+// specified file, which should be in CSV format with an identifier followed by
+// the same number of associated values on every line. Returns the identifiers
+// and the value columns, where the k-th column holds the k-th associated value
+// of every identifier. The values are kept as plain nonnegative int64s, which
+// avoids allocating a BigNum per value for large files.
+util::StatusOr<
+    std::pair<std::vector<std::string>, std::vector<std::vector<int64_t>>>>
+ReadClientDatasetWithValueColumnsFromFile(
+    absl::string_view client_data_filename);
+
 }  // namespace private_join_and_compute
 #endif  // OPEN_SOURCE_DATA_UTIL_H_
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "element_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glog/logging.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// Filters with more hash functions are rejected as corrupt.
+const int kMaxNumHashes = 64;
+
+// Filters with more bits, 128 GiB, are rejected as corrupt. A filter of a
+// billion elements with a false positive rate of 1e-6 has about 2^35 bits.
+const uint64_t kMaxNumBits = uint64_t{1} << 40;
+
+// Returns 8 bytes of the hash starting at offset as a little-endian integer.
+uint64_t Load64(const std::string& hash, int offset) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | static_cast<uint8_t>(hash[offset + i]);
+  }
+  return value;
+}
+
+}  // namespace
+
+ElementFilter::ElementFilter(int64_t num_elements,
+                             double false_positive_rate) {
+  CHECK(false_positive_rate > 0 && false_positive_rate < 1);
+  // The optimal Bloom filter has -n ln(p) / ln(2)^2 bits and ln(2) m / n hash
+  // functions.
+  const double n = std::max<int64_t>(1, num_elements);
+  const double ln2 = std::log(2.0);
+  num_bits_ = std::max<uint64_t>(
+      8, static_cast<uint64_t>(
+             std::ceil(-n * std::log(false_positive_rate) / (ln2 * ln2))));
+  num_hashes_ = std::min(
+      kMaxNumHashes,
+      std::max(1, static_cast<int>(std::round(ln2 * num_bits_ / n))));
+  bits_.assign((num_bits_ + 7) / 8, '\0');
+}
+
+ElementFilter::ElementFilter(uint64_t num_bits, int num_hashes,
+                             std::string bits)
+    : num_bits_(num_bits), num_hashes_(num_hashes), bits_(std::move(bits)) {}
+
+util::StatusOr<ElementFilter> ElementFilter::FromProto(
+    const ServerFilter& proto) {
+  // The number of bytes is compared without rounding num_bits up, which could
+  // overflow.
+  if (proto.num_bits() == 0 || proto.num_bits() > kMaxNumBits ||
+      proto.num_hashes() < 1 || proto.num_hashes() > kMaxNumHashes ||
+      proto.bits().size() !=
+          proto.num_bits() / 8 + (proto.num_bits() % 8 != 0)) {
+    return util::InvalidArgumentError(
+        "ElementFilter::FromProto: Inconsistent filter.");
+  }
+  return ElementFilter(proto.num_bits(), proto.num_hashes(), proto.bits());
+}
+
+std::pair<uint64_t, uint64_t> ElementFilter::Hashes(
+    Context* ctx, absl::string_view element) {
+  std::string hash = ctx->Sha256String(std::string(element));
+  // An odd step visits distinct positions for any power of two number of bits
+  // and rarely repeats otherwise.
+  return {Load64(hash, 0), Load64(hash, 8) | 1};
+}
+
+void ElementFilter::Add(Context* ctx, absl::string_view element) {
+  std::pair<uint64_t, uint64_t> hashes = Hashes(ctx, element);
+  for (int i = 0; i < num_hashes_; i++) {
+    uint64_t position = (hashes.first + i * hashes.second) % num_bits_;
+    bits_[position / 8] |= static_cast<char>(1 << (position % 8));
+  }
+}
+
+bool ElementFilter::MayContain(Context* ctx, absl::string_view element) const {
+  std::pair<uint64_t, uint64_t> hashes = Hashes(ctx, element);
+  for (int i = 0; i < num_hashes_; i++) {
+    uint64_t position = (hashes.first + i * hashes.second) % num_bits_;
+    if ((bits_[position / 8] & (1 << (position % 8))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ServerFilter ElementFilter::ToProto() const {
+  ServerFilter proto;
+  proto.set_num_bits(num_bits_);
+  proto.set_num_hashes(num_hashes_);
+  *proto.mutable_bits() = bits_;
+  return proto;
+}
+
+}  // namespace private_join_and_compute
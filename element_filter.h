@@ -0,0 +1,68 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_ELEMENT_FILTER_H_
+#define OPEN_SOURCE_ELEMENT_FILTER_H_
+
+// Contains the Bloom filter the server of the unbalanced mode builds over its
+// encrypted set. Its positions are derived from the SHA-256 hash of each
+// element, so that filters built on one machine can be queried on another.
+
+#include <cstdint>
+#include <string>
+
+#include "crypto/context.h"
+#include "match.pb.h"
+#include "util/status.inc"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+class ElementFilter {
+ public:
+  // Returns an empty filter sized so that, once num_elements elements are
+  // added, an element that was not added is reported with probability at most
+  // false_positive_rate, which must be in (0, 1).
+  ElementFilter(int64_t num_elements, double false_positive_rate);
+
+  // Returns the filter stored in the proto.
+  //
+  // Fails with INVALID_ARGUMENT if the proto is inconsistent.
+  static util::StatusOr<ElementFilter> FromProto(const ServerFilter& proto);
+
+  void Add(Context* ctx, absl::string_view element);
+
+  // Returns true if the element was added, and with a small probability if it
+  // was not.
+  bool MayContain(Context* ctx, absl::string_view element) const;
+
+  // Returns the proto storing the filter, without a key check.
+  ServerFilter ToProto() const;
+
+ private:
+  ElementFilter(uint64_t num_bits, int num_hashes, std::string bits);
+
+  // Returns the two hashes from which the positions of the element follow.
+  static std::pair<uint64_t, uint64_t> Hashes(Context* ctx,
+                                              absl::string_view element);
+
+  uint64_t num_bits_;
+  int num_hashes_;
+  std::string bits_;
+};
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_ELEMENT_FILTER_H_
@@ -0,0 +1,411 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "external_intersection.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <queue>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// The bytes a buffered element uses besides its own: its end offset and index
+// while buffered, and its view and position in the order while sorted.
+const size_t kElementOverhead =
+    3 * sizeof(size_t) + sizeof(absl::string_view);
+
+// The smallest read buffer of a run during the merge.
+const size_t kMinReadBufferSize = 4096;
+
+// The most run files merged at once. More runs are first merged in groups of
+// this many into longer runs, so that the open files stay well below the usual
+// limit of 1024 file descriptors.
+const size_t kMaxMergeFanIn = 256;
+
+// Writes a record of a run: the length of the element as a uint32_t, the
+// element and its index as a uint64_t. Returns false on failure.
+bool WriteRecord(FILE* file, absl::string_view element, uint64_t index) {
+  uint32_t length = static_cast<uint32_t>(element.size());
+  return fwrite(&length, sizeof(length), 1, file) == 1 &&
+         fwrite(element.data(), 1, length, file) == length &&
+         fwrite(&index, sizeof(index), 1, file) == 1;
+}
+
+// A sorted stream of client elements with their indices.
+class RunReader {
+ public:
+  virtual ~RunReader() = default;
+
+  // Moves to the next element, or returns false at the end of the run.
+  virtual bool Next() = 0;
+
+  // Returns OK unless the run could not be read.
+  virtual util::Status status() const { return util::OkStatus(); }
+
+  absl::string_view element() const { return element_; }
+  size_t index() const { return index_; }
+
+ protected:
+  absl::string_view element_;
+  size_t index_ = 0;
+};
+
+// Reads the records written by WriteRecord.
+class FileRunReader : public RunReader {
+ public:
+  FileRunReader(const std::string& path, size_t buffer_size)
+      : path_(path), buffer_(buffer_size) {
+    file_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+    file_.open(path, std::ios::binary);
+    if (!file_.is_open()) {
+      status_ = util::InternalError(
+          absl::StrCat("FileRunReader: Couldn't open run file: ", path));
+    }
+  }
+
+  bool Next() override {
+    if (!status_.ok()) {
+      return false;
+    }
+    uint32_t length;
+    if (!file_.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+      if (file_.gcount() != 0) {
+        status_ = Truncated();
+      }
+      return false;
+    }
+    uint64_t index;
+    record_.resize(length);
+    if (!file_.read(&record_[0], length) ||
+        !file_.read(reinterpret_cast<char*>(&index), sizeof(index))) {
+      status_ = Truncated();
+      return false;
+    }
+    element_ = record_;
+    index_ = static_cast<size_t>(index);
+    return true;
+  }
+
+  util::Status status() const override { return status_; }
+
+ private:
+  util::Status Truncated() const {
+    return util::InternalError(
+        absl::StrCat("FileRunReader: Truncated run file: ", path_));
+  }
+
+  std::string path_;
+  std::vector<char> buffer_;
+  std::ifstream file_;
+  std::string record_;
+  util::Status status_;
+};
+
+// Reads the sorted elements still buffered in memory.
+class MemoryRunReader : public RunReader {
+ public:
+  MemoryRunReader(std::vector<absl::string_view> views,
+                  std::vector<size_t> order,
+                  const std::vector<size_t>& indices)
+      : views_(std::move(views)), order_(std::move(order)), indices_(indices) {}
+
+  bool Next() override {
+    if (next_ == order_.size()) {
+      return false;
+    }
+    element_ = views_[order_[next_]];
+    index_ = indices_[order_[next_]];
+    next_++;
+    return true;
+  }
+
+ private:
+  std::vector<absl::string_view> views_;
+  std::vector<size_t> order_;
+  const std::vector<size_t>& indices_;
+  size_t next_ = 0;
+};
+
+// Merges sorted runs into one sorted stream.
+class MergedRunReader : public RunReader {
+ public:
+  explicit MergedRunReader(std::vector<std::unique_ptr<RunReader>> readers)
+      : readers_(std::move(readers)), heap_(&Greater) {}
+
+  bool Next() override {
+    if (!started_) {
+      started_ = true;
+      for (const auto& reader : readers_) {
+        if (reader->Next()) {
+          heap_.push(reader.get());
+        }
+      }
+    } else if (!heap_.empty()) {
+      RunReader* reader = heap_.top();
+      heap_.pop();
+      if (reader->Next()) {
+        heap_.push(reader);
+      }
+    }
+    if (heap_.empty()) {
+      return false;
+    }
+    element_ = heap_.top()->element();
+    index_ = heap_.top()->index();
+    return true;
+  }
+
+  util::Status status() const override {
+    for (const auto& reader : readers_) {
+      if (!reader->status().ok()) {
+        return reader->status();
+      }
+    }
+    return util::OkStatus();
+  }
+
+ private:
+  // Orders the heap as a min-heap of the runs by their current element.
+  static bool Greater(const RunReader* a, const RunReader* b) {
+    return a->element() > b->element();
+  }
+
+  std::vector<std::unique_ptr<RunReader>> readers_;
+  std::priority_queue<RunReader*, std::vector<RunReader*>,
+                      bool (*)(const RunReader*, const RunReader*)>
+      heap_;
+  bool started_ = false;
+};
+
+// Opens the first num_runs of the run files, and fails as soon as one of them
+// cannot be opened.
+util::Status OpenRuns(const std::vector<std::string>& run_paths,
+                      size_t num_runs, size_t read_buffer_size,
+                      std::vector<std::unique_ptr<RunReader>>* readers) {
+  for (size_t i = 0; i < num_runs; i++) {
+    readers->push_back(
+        absl::make_unique<FileRunReader>(run_paths[i], read_buffer_size));
+    if (!readers->back()->status().ok()) {
+      return readers->back()->status();
+    }
+  }
+  return util::OkStatus();
+}
+
+}  // namespace
+
+ExternalIntersection::ExternalIntersection(absl::string_view temp_dir,
+                                           size_t memory_budget)
+    : temp_dir_(temp_dir), memory_budget_(memory_budget) {}
+
+util::StatusOr<std::unique_ptr<ExternalIntersection>>
+ExternalIntersection::Create(absl::string_view temp_dir,
+                             size_t memory_budget) {
+  if (memory_budget == 0) {
+    return util::InvalidArgumentError(
+        "ExternalIntersection: The memory budget must be positive.");
+  }
+  DIR* dir = opendir(std::string(temp_dir).c_str());
+  if (dir == nullptr) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "ExternalIntersection: Couldn't open temporary directory: ",
+        temp_dir));
+  }
+  closedir(dir);
+  return absl::WrapUnique(new ExternalIntersection(temp_dir, memory_budget));
+}
+
+ExternalIntersection::~ExternalIntersection() {
+  for (const std::string& path : run_paths_) {
+    std::remove(path.c_str());
+  }
+}
+
+util::Status ExternalIntersection::AddClientElement(absl::string_view element,
+                                                    size_t index) {
+  buffer_.Add(element);
+  buffer_indices_.push_back(index);
+  buffered_bytes_ += element.size() + kElementOverhead;
+  if (buffered_bytes_ >= memory_budget_) {
+    return SpillRun();
+  }
+  return util::OkStatus();
+}
+
+std::vector<size_t> ExternalIntersection::SortedBufferOrder(
+    const std::vector<absl::string_view>& views) const {
+  std::vector<size_t> order(views.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&views](size_t a, size_t b) { return views[a] < views[b]; });
+  return order;
+}
+
+util::StatusOr<FILE*> ExternalIntersection::CreateRunFile() {
+  // mkstemp creates the file exclusively and readable by its owner only, so
+  // another user of a shared temporary directory can neither read the run nor
+  // redirect it through a planted symlink.
+  std::string path = absl::StrCat(temp_dir_, "/.intersection-run-XXXXXX");
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    return util::InternalError(absl::StrCat(
+        "ExternalIntersection: Couldn't create run file in: ", temp_dir_));
+  }
+  run_paths_.push_back(path);
+  FILE* file = fdopen(fd, "wb");
+  if (file == nullptr) {
+    close(fd);
+    return util::InternalError(
+        absl::StrCat("ExternalIntersection: Couldn't open run file: ", path));
+  }
+  return file;
+}
+
+util::Status ExternalIntersection::SpillRun() {
+  util::StatusOr<FILE*> maybe_file = CreateRunFile();
+  if (!maybe_file.ok()) {
+    return maybe_file.status();
+  }
+  FILE* file = maybe_file.ValueOrDie();
+
+  std::vector<absl::string_view> views = buffer_.Views();
+  bool written = true;
+  for (size_t position : SortedBufferOrder(views)) {
+    written = written && WriteRecord(file, views[position],
+                                     buffer_indices_[position]);
+  }
+  if (fclose(file) != 0 || !written) {
+    return util::InternalError(
+        absl::StrCat("ExternalIntersection: Couldn't write to or close run "
+                     "file: ",
+                     run_paths_.back()));
+  }
+
+  buffer_ = PackedElements();
+  buffer_indices_.clear();
+  buffer_indices_.shrink_to_fit();
+  buffered_bytes_ = 0;
+  return util::OkStatus();
+}
+
+size_t ExternalIntersection::ReadBufferSize(size_t num_runs) const {
+  // The runs share what the budget leaves besides the elements still in
+  // memory.
+  return std::max(kMinReadBufferSize,
+                  (memory_budget_ - std::min(memory_budget_, buffered_bytes_)) /
+                      std::max<size_t>(1, num_runs));
+}
+
+util::Status ExternalIntersection::MergeRuns() {
+  while (run_paths_.size() > kMaxMergeFanIn) {
+    util::StatusOr<FILE*> maybe_file = CreateRunFile();
+    if (!maybe_file.ok()) {
+      return maybe_file.status();
+    }
+    FILE* file = maybe_file.ValueOrDie();
+    std::vector<std::unique_ptr<RunReader>> readers;
+    util::Status status = OpenRuns(run_paths_, kMaxMergeFanIn,
+                                   ReadBufferSize(kMaxMergeFanIn), &readers);
+    MergedRunReader merged(std::move(readers));
+    bool written = true;
+    while (status.ok() && written && merged.Next()) {
+      written = WriteRecord(file, merged.element(), merged.index());
+    }
+    if (fclose(file) != 0 || !written) {
+      return util::InternalError(
+          absl::StrCat("ExternalIntersection: Couldn't write to or close run "
+                       "file: ",
+                       run_paths_.back()));
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    if (!merged.status().ok()) {
+      return merged.status();
+    }
+    for (size_t i = 0; i < kMaxMergeFanIn; i++) {
+      std::remove(run_paths_[i].c_str());
+    }
+    run_paths_.erase(run_paths_.begin(), run_paths_.begin() + kMaxMergeFanIn);
+  }
+  return util::OkStatus();
+}
+
+util::Status ExternalIntersection::Match(size_t num_server_elements,
+                                         const ServerElementFn& server_element,
+                                         const MatchFn& on_match) {
+  util::Status status = MergeRuns();
+  if (!status.ok()) {
+    return status;
+  }
+  std::vector<std::unique_ptr<RunReader>> readers;
+  status = OpenRuns(run_paths_, run_paths_.size(),
+                    ReadBufferSize(run_paths_.size()), &readers);
+  if (!status.ok()) {
+    return status;
+  }
+  if (buffer_.size() > 0) {
+    std::vector<absl::string_view> views = buffer_.Views();
+    std::vector<size_t> order = SortedBufferOrder(views);
+    readers.push_back(absl::make_unique<MemoryRunReader>(
+        std::move(views), std::move(order), buffer_indices_));
+  }
+  MergedRunReader client_elements(std::move(readers));
+
+  // The previous server element is copied, since server_element may reuse the
+  // storage of its result.
+  size_t server_position = 0;
+  std::string previous_server_element;
+  bool has_client_element = client_elements.Next();
+  while (has_client_element && server_position < num_server_elements) {
+    absl::string_view current_server_element;
+    if (!server_element(server_position, &current_server_element)) {
+      return util::InvalidArgumentError(
+          "ExternalIntersection: Couldn't read a server element.");
+    }
+    if (server_position > 0 &&
+        current_server_element < previous_server_element) {
+      return util::InvalidArgumentError(
+          "ExternalIntersection: The server elements are not sorted.");
+    }
+    int comparison =
+        client_elements.element().compare(current_server_element);
+    if (comparison <= 0) {
+      if (comparison == 0) {
+        on_match(client_elements.index());
+      }
+      has_client_element = client_elements.Next();
+    }
+    if (comparison >= 0) {
+      previous_server_element.assign(current_server_element.data(),
+                                     current_server_element.size());
+      server_position++;
+    }
+  }
+  return client_elements.status();
+}
+
+}  // namespace private_join_and_compute
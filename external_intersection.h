@@ -0,0 +1,124 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_EXTERNAL_INTERSECTION_H_
+#define OPEN_SOURCE_EXTERNAL_INTERSECTION_H_
+
+// Contains an out-of-core variant of the intersection, for client sets whose
+// re-encrypted elements do not fit in memory.
+//
+// The client elements are buffered up to a memory budget. Whenever the buffer
+// is full, it is sorted and spilled to a run file in a temporary directory,
+// together with the index of each element in the client's set. Matching k-way
+// merges the runs into one sorted stream, which is merged with the sorted
+// server elements, and reports the matches one at a time. At most 256 run files
+// are open at once: with more runs, groups of 256 are first merged into longer
+// runs, in as many passes as needed.
+//
+// The matches follow the same multiset semantics as IntersectIndices.
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "intersection.h"
+#include "util/status.inc"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+class ExternalIntersection {
+ public:
+  // Sets *element to the server element at the given position, or returns
+  // false if it couldn't be produced.
+  using ServerElementFn =
+      std::function<bool(size_t, absl::string_view* element)>;
+  // Receives the index of a matched client element.
+  using MatchFn = std::function<void(size_t)>;
+
+  // Returns an ExternalIntersection that spills runs into temp_dir whenever
+  // its buffered client elements use more than memory_budget bytes.
+  //
+  // Fails with INVALID_ARGUMENT if temp_dir is not a readable directory or the
+  // budget is zero.
+  static util::StatusOr<std::unique_ptr<ExternalIntersection>> Create(
+      absl::string_view temp_dir, size_t memory_budget);
+
+  ExternalIntersection(const ExternalIntersection&) = delete;
+  ExternalIntersection& operator=(const ExternalIntersection&) = delete;
+
+  // Deletes the run files.
+  ~ExternalIntersection();
+
+  // Adds a client element with its index in the client's set.
+  //
+  // Fails with INTERNAL if a run could not be written.
+  util::Status AddClientElement(absl::string_view element, size_t index);
+
+  // Merges the client elements added so far with the num_server_elements
+  // server elements, which must be sorted, and calls on_match with the index
+  // of each matched client element, in increasing order of the elements. Must
+  // be called at most once.
+  //
+  // server_element is called with non-decreasing positions, so it may decode
+  // the server elements as a stream.
+  //
+  // Fails with INVALID_ARGUMENT if the server elements turn out not to be
+  // sorted or server_element fails, which stops the merge, and with INTERNAL
+  // if a run could not be opened, read or written. on_match may have been
+  // called for some matches by then.
+  util::Status Match(size_t num_server_elements,
+                     const ServerElementFn& server_element,
+                     const MatchFn& on_match);
+
+  // Returns the number of runs spilled to disk so far.
+  int num_runs() const { return static_cast<int>(run_paths_.size()); }
+
+ private:
+  ExternalIntersection(absl::string_view temp_dir, size_t memory_budget);
+
+  // Creates a new run file and adds it to run_paths_.
+  util::StatusOr<FILE*> CreateRunFile();
+
+  // Sorts the buffered elements, writes them to a new run file and empties
+  // the buffer.
+  util::Status SpillRun();
+
+  // Merges the oldest runs into new ones until few enough runs are left to
+  // merge them all at once.
+  util::Status MergeRuns();
+
+  // Returns the read buffer size of each of num_runs runs merged at once.
+  size_t ReadBufferSize(size_t num_runs) const;
+
+  // Returns the positions of the buffered elements in sorted order.
+  std::vector<size_t> SortedBufferOrder(
+      const std::vector<absl::string_view>& views) const;
+
+  std::string temp_dir_;
+  size_t memory_budget_;
+
+  PackedElements buffer_;
+  std::vector<size_t> buffer_indices_;
+  size_t buffered_bytes_ = 0;
+
+  std::vector<std::string> run_paths_;
+};
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_EXTERNAL_INTERSECTION_H_
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fingerprint.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glog/logging.h"
+
+namespace private_join_and_compute {
+
+int FingerprintBytes(int64_t client_size, int64_t server_size,
+                     double false_positive_rate) {
+  CHECK_GT(false_positive_rate, 0);
+  // Each of the client_size * server_size pairs of distinct points collides
+  // with probability 2^-bits.
+  double pairs = static_cast<double>(std::max<int64_t>(1, client_size)) *
+                 static_cast<double>(std::max<int64_t>(1, server_size));
+  double bits = std::ceil(std::log2(pairs / false_positive_rate));
+  int num_bytes = static_cast<int>(std::ceil(std::max(0.0, bits) / 8));
+  return std::min(kMaxFingerprintBytes,
+                  std::max(kMinFingerprintBytes, num_bytes));
+}
+
+std::string Fingerprint(Context* ctx, absl::string_view element,
+                        int num_bytes) {
+  CHECK(num_bytes > 0 && num_bytes <= kMaxFingerprintBytes);
+  std::string hash = ctx->Sha256String(std::string(element));
+  hash.resize(num_bytes);
+  return hash;
+}
+
+}  // namespace private_join_and_compute
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_FINGERPRINT_H_
+#define OPEN_SOURCE_FINGERPRINT_H_
+
+// Contains the fingerprints that may replace the doubly encrypted points when
+// matching. Only equality of the points matters, so the client can send short
+// hashes of its re-encryption of the server's set, and the server hashes its
+// re-encryption of the client's set the same way. Distinct points collide with
+// probability 2^-(8 * fingerprint bytes).
+
+#include <cstdint>
+#include <string>
+
+#include "crypto/context.h"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+// Fingerprints are prefixes of SHA-256 hashes, so they have at most 32 bytes.
+const int kMaxFingerprintBytes = 32;
+
+// Fingerprints have at least 8 bytes, whatever the set sizes.
+const int kMinFingerprintBytes = 8;
+
+// Returns the number of bytes of the fingerprints for matching client_size
+// client elements with server_size server elements, such that the expected
+// number of false matches is at most false_positive_rate.
+//
+// false_positive_rate must be positive.
+int FingerprintBytes(int64_t client_size, int64_t server_size,
+                     double false_positive_rate);
+
+// Returns the first num_bytes bytes of the SHA-256 hash of the element.
+std::string Fingerprint(Context* ctx, absl::string_view element,
+                        int num_bytes);
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_FINGERPRINT_H_
@@ -0,0 +1,418 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intersection.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <thread>  // NOLINT
+
+#include "glog/logging.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// How many elements ahead of the current one the hash join prefetches the
+// table slot of.
+const size_t kPrefetchDistance = 16;
+
+// Marks a missing element index in the hash join.
+const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+// The bits of a hash that the concurrent table keeps next to the position of
+// the element.
+const uint64_t kHashTagMask = 0xffffffff00000000;
+
+// The largest supported number of radix bits.
+const int kMaxRadixBits = 16;
+
+using ElementSpan = absl::Span<const absl::string_view>;
+using HashSpan = absl::Span<const uint64_t>;
+
+// Returns the hashes of the elements.
+std::vector<uint64_t> HashAll(ElementSpan elements) {
+  std::vector<uint64_t> hashes;
+  hashes.reserve(elements.size());
+  absl::Hash<absl::string_view> hasher;
+  for (absl::string_view element : elements) {
+    hashes.push_back(hasher(element));
+  }
+  return hashes;
+}
+
+// The server elements are sorted first, unless server_elements_sorted says
+// they already are and a linear pass confirms it.
+std::vector<size_t> SortMergeIntersect(ElementSpan client_elements,
+                                       ElementSpan server_elements,
+                                       bool server_elements_sorted) {
+  std::vector<size_t> client_order(client_elements.size());
+  std::iota(client_order.begin(), client_order.end(), 0);
+  std::sort(client_order.begin(), client_order.end(),
+            [&client_elements](size_t a, size_t b) {
+              return client_elements[a] < client_elements[b];
+            });
+  std::vector<absl::string_view> sorted_server_copy;
+  ElementSpan sorted_server_elements = server_elements;
+  if (!server_elements_sorted ||
+      !std::is_sorted(server_elements.begin(), server_elements.end())) {
+    sorted_server_copy.assign(server_elements.begin(), server_elements.end());
+    std::sort(sorted_server_copy.begin(), sorted_server_copy.end());
+    sorted_server_elements = sorted_server_copy;
+  }
+
+  std::vector<size_t> matches;
+  auto client_it = client_order.begin();
+  auto server_it = sorted_server_elements.begin();
+  while (client_it != client_order.end() &&
+         server_it != sorted_server_elements.end()) {
+    const absl::string_view client_element = client_elements[*client_it];
+    if (client_element < *server_it) {
+      ++client_it;
+    } else if (*server_it < client_element) {
+      ++server_it;
+    } else {
+      matches.push_back(*client_it);
+      ++client_it;
+      ++server_it;
+    }
+  }
+  return matches;
+}
+
+// An open-addressing hash table with linear probing over the elements of one
+// side of the join. Each distinct element occupies one slot, which chains the
+// indices of all its occurrences so that every occurrence is matched at most
+// once.
+class ElementTable {
+ public:
+  ElementTable(ElementSpan elements, HashSpan hashes)
+      : elements_(elements), next_(elements.size(), kNone) {
+    CHECK_LT(elements.size(), kNone) << "Too many elements for the hash join.";
+    size_t capacity = 16;
+    while (capacity < 2 * elements.size()) {
+      capacity *= 2;
+    }
+    slots_.assign(capacity, Slot{0, kNone, kNone});
+    mask_ = capacity - 1;
+
+    // Inserts in reverse so that each chain lists the occurrences in order.
+    for (size_t i = elements.size(); i-- > 0;) {
+      if (i >= kPrefetchDistance) {
+        Prefetch(hashes[i - kPrefetchDistance]);
+      }
+      Slot* slot = Find(hashes[i], elements[i]);
+      if (slot->key == kNone) {
+        *slot = Slot{hashes[i], static_cast<uint32_t>(i), kNone};
+      }
+      next_[i] = slot->head;
+      slot->head = static_cast<uint32_t>(i);
+    }
+  }
+
+  // Brings the first slot probed for the hash into the cache.
+  void Prefetch(uint64_t hash) const {
+    __builtin_prefetch(&slots_[hash & mask_]);
+  }
+
+  // Takes one occurrence of the element, which has the given hash, stores its
+  // index in *index and returns true. Returns false if none is left.
+  bool Take(uint64_t hash, absl::string_view element, size_t* index) {
+    Slot* slot = Find(hash, element);
+    if (slot->head == kNone) {
+      return false;
+    }
+    *index = slot->head;
+    slot->head = next_[slot->head];
+    return true;
+  }
+
+ private:
+  struct Slot {
+    uint64_t hash;
+    // The index of an occurrence of the element of this slot, or kNone if the
+    // slot is empty.
+    uint32_t key;
+    // The index of the first occurrence not taken yet, or kNone.
+    uint32_t head;
+  };
+
+  // Returns the slot of the element, or the empty slot where it belongs.
+  Slot* Find(uint64_t hash, absl::string_view element) {
+    for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+      Slot* slot = &slots_[i];
+      if (slot->key == kNone ||
+          (slot->hash == hash && elements_[slot->key] == element)) {
+        return slot;
+      }
+    }
+  }
+
+  ElementSpan elements_;
+  // The index of the next occurrence of the same element, or kNone.
+  std::vector<uint32_t> next_;
+  std::vector<Slot> slots_;
+  size_t mask_;
+};
+
+std::vector<size_t> HashJoinIntersect(ElementSpan client_elements,
+                                      HashSpan client_hashes,
+                                      ElementSpan server_elements,
+                                      HashSpan server_hashes) {
+  const bool build_on_client = client_elements.size() <= server_elements.size();
+  ElementSpan build_elements =
+      build_on_client ? client_elements : server_elements;
+  ElementSpan probe_elements =
+      build_on_client ? server_elements : client_elements;
+  HashSpan probe_hashes = build_on_client ? server_hashes : client_hashes;
+
+  ElementTable table(build_elements,
+                     build_on_client ? client_hashes : server_hashes);
+  std::vector<size_t> matches;
+  for (size_t i = 0; i < probe_elements.size(); i++) {
+    if (i + kPrefetchDistance < probe_elements.size()) {
+      table.Prefetch(probe_hashes[i + kPrefetchDistance]);
+    }
+    size_t build_index;
+    if (table.Take(probe_hashes[i], probe_elements[i], &build_index)) {
+      matches.push_back(build_on_client ? build_index : i);
+    }
+  }
+  return matches;
+}
+
+// The elements of one side scattered into buckets by the leading bits of their
+// hashes. The elements of bucket b are at positions [offsets[b], offsets[b+1]).
+struct Partitions {
+  std::vector<absl::string_view> elements;
+  std::vector<uint64_t> hashes;
+  // The index of each element in the unpartitioned side.
+  std::vector<size_t> indices;
+  std::vector<size_t> offsets;
+
+  ElementSpan BucketElements(size_t bucket) const {
+    return ElementSpan(elements).subspan(
+        offsets[bucket], offsets[bucket + 1] - offsets[bucket]);
+  }
+  HashSpan BucketHashes(size_t bucket) const {
+    return HashSpan(hashes).subspan(offsets[bucket],
+                                    offsets[bucket + 1] - offsets[bucket]);
+  }
+};
+
+// Scatters the elements into 2^radix_bits buckets, keeping the order of the
+// elements within each bucket.
+Partitions Scatter(const std::vector<absl::string_view>& elements,
+                   int radix_bits) {
+  std::vector<uint64_t> hashes = HashAll(elements);
+  const size_t num_buckets = size_t{1} << radix_bits;
+  auto bucket_of = [radix_bits](uint64_t hash) -> size_t {
+    return radix_bits == 0 ? 0 : hash >> (64 - radix_bits);
+  };
+
+  Partitions partitions;
+  partitions.offsets.assign(num_buckets + 1, 0);
+  for (uint64_t hash : hashes) {
+    partitions.offsets[bucket_of(hash) + 1]++;
+  }
+  std::partial_sum(partitions.offsets.begin(), partitions.offsets.end(),
+                   partitions.offsets.begin());
+
+  partitions.elements.resize(elements.size());
+  partitions.hashes.resize(elements.size());
+  partitions.indices.resize(elements.size());
+  std::vector<size_t> next(partitions.offsets.begin(),
+                           partitions.offsets.end() - 1);
+  for (size_t i = 0; i < elements.size(); i++) {
+    size_t position = next[bucket_of(hashes[i])]++;
+    partitions.elements[position] = elements[i];
+    partitions.hashes[position] = hashes[i];
+    partitions.indices[position] = i;
+  }
+  return partitions;
+}
+
+}  // namespace
+
+void PackedElements::Reserve(size_t num_elements, size_t num_bytes) {
+  bytes_.reserve(num_bytes);
+  ends_.reserve(num_elements);
+}
+
+void PackedElements::Add(absl::string_view element) {
+  bytes_.append(element.data(), element.size());
+  ends_.push_back(bytes_.size());
+}
+
+std::vector<absl::string_view> PackedElements::Views() const {
+  std::vector<absl::string_view> views;
+  views.reserve(ends_.size());
+  size_t begin = 0;
+  for (size_t end : ends_) {
+    views.emplace_back(bytes_.data() + begin, end - begin);
+    begin = end;
+  }
+  return views;
+}
+
+util::StatusOr<IntersectionEngine> ParseIntersectionEngine(
+    absl::string_view name) {
+  if (name == "sort_merge") {
+    return IntersectionEngine::kSortMerge;
+  }
+  if (name == "hash_join") {
+    return IntersectionEngine::kHashJoin;
+  }
+  return util::InvalidArgumentError(
+      absl::StrCat("Unknown intersection engine: ", name));
+}
+
+std::vector<size_t> IntersectIndices(
+    IntersectionEngine engine,
+    const std::vector<absl::string_view>& client_elements,
+    const std::vector<absl::string_view>& server_elements,
+    bool server_elements_sorted) {
+  switch (engine) {
+    case IntersectionEngine::kSortMerge:
+      return SortMergeIntersect(client_elements, server_elements,
+                                server_elements_sorted);
+    case IntersectionEngine::kHashJoin:
+      return HashJoinIntersect(client_elements, HashAll(client_elements),
+                               server_elements, HashAll(server_elements));
+  }
+  LOG(FATAL) << "Unknown intersection engine.";
+}
+
+ConcurrentElementTable::ConcurrentElementTable(
+    const std::vector<absl::string_view>& server_elements)
+    : server_elements_(server_elements) {
+  CHECK_LT(server_elements.size(), kNone)
+      << "Too many elements for the concurrent table.";
+  size_t capacity = 16;
+  while (capacity < 2 * server_elements.size()) {
+    capacity *= 2;
+  }
+  slots_.reset(new Slot[capacity]);
+  mask_ = capacity - 1;
+}
+
+bool ConcurrentElementTable::Matches(uint64_t state, uint64_t hash,
+                                     absl::string_view element) const {
+  return state != 0 && (state & kHashTagMask) == (hash & kHashTagMask) &&
+         server_elements_[(state & ~kHashTagMask) - 1] == element;
+}
+
+ConcurrentElementTable::Slot* ConcurrentElementTable::Find(
+    uint64_t hash, absl::string_view element) const {
+  for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+    Slot* slot = &slots_[i];
+    uint64_t state = slot->state.load(std::memory_order_acquire);
+    if (state == 0 || Matches(state, hash, element)) {
+      return slot;
+    }
+  }
+}
+
+void ConcurrentElementTable::Insert(size_t position) {
+  const absl::string_view element = server_elements_[position];
+  const uint64_t hash = absl::Hash<absl::string_view>()(element);
+  const uint64_t state = (hash & kHashTagMask) | (position + 1);
+  for (;;) {
+    // Claims the slot if it is still empty. Otherwise another thread filled it
+    // first, and the search goes on unless it holds the same element.
+    Slot* slot = Find(hash, element);
+    uint64_t expected = 0;
+    if (slot->state.compare_exchange_strong(expected, state,
+                                            std::memory_order_acq_rel) ||
+        Matches(expected, hash, element)) {
+      slot->count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+bool ConcurrentElementTable::Take(absl::string_view element) {
+  Slot* slot = Find(absl::Hash<absl::string_view>()(element), element);
+  uint32_t count = slot->count.load(std::memory_order_relaxed);
+  while (count > 0) {
+    if (slot->count.compare_exchange_weak(count, count - 1,
+                                          std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PartitionedIntersectIndices(
+    IntersectionEngine engine,
+    const std::vector<absl::string_view>& client_elements,
+    const std::vector<absl::string_view>& server_elements,
+    bool server_elements_sorted, int radix_bits, int num_threads,
+    const PartitionMatchCallback& on_matches) {
+  CHECK(radix_bits >= 0 && radix_bits <= kMaxRadixBits)
+      << "radix_bits must be in [0, " << kMaxRadixBits << "].";
+  CHECK_GE(num_threads, 1);
+  const Partitions client = Scatter(client_elements, radix_bits);
+  const Partitions server = Scatter(server_elements, radix_bits);
+  const size_t num_buckets = client.offsets.size() - 1;
+
+  // The workers claim the buckets in order, so that a few large buckets do not
+  // keep the other workers idle.
+  std::atomic<size_t> next_bucket(0);
+  auto work = [&](int worker) {
+    std::vector<size_t> matches;
+    for (size_t bucket = next_bucket++; bucket < num_buckets;
+         bucket = next_bucket++) {
+      ElementSpan client_bucket = client.BucketElements(bucket);
+      ElementSpan server_bucket = server.BucketElements(bucket);
+      if (client_bucket.empty() || server_bucket.empty()) {
+        continue;
+      }
+      std::vector<size_t> bucket_matches;
+      switch (engine) {
+        case IntersectionEngine::kSortMerge:
+          bucket_matches = SortMergeIntersect(client_bucket, server_bucket,
+                                              server_elements_sorted);
+          break;
+        case IntersectionEngine::kHashJoin:
+          bucket_matches = HashJoinIntersect(
+              client_bucket, client.BucketHashes(bucket), server_bucket,
+              server.BucketHashes(bucket));
+          break;
+      }
+      matches.clear();
+      for (size_t index : bucket_matches) {
+        matches.push_back(client.indices[client.offsets[bucket] + index]);
+      }
+      on_matches(worker, matches);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int worker = 1; worker < num_threads; worker++) {
+    threads.emplace_back(work, worker);
+  }
+  work(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace private_join_and_compute
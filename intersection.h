@@ -0,0 +1,161 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_INTERSECTION_H_
+#define OPEN_SOURCE_INTERSECTION_H_
+
+// Contains the algorithms the server can use to match the doubly encrypted
+// elements of the two parties.
+//
+// All engines compute the same multiset intersection: an element occurring a
+// times on the client side and b times on the server side is matched min(a, b)
+// times. Which of several equal client elements are matched is unspecified.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/status.inc"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+enum class IntersectionEngine {
+  // Sorts both sides and merges them.
+  kSortMerge,
+  // Builds an open-addressing hash table on the smaller side and probes it
+  // with the other, in linear expected time.
+  kHashJoin,
+};
+
+// The keys of one side of the intersection, stored back to back in a single
+// buffer. Matching on them touches one compact array instead of a string per
+// element, which would sit next to its associated data in the messages.
+class PackedElements {
+ public:
+  PackedElements() = default;
+
+  // Reserves room for num_elements elements of num_bytes bytes in total.
+  void Reserve(size_t num_elements, size_t num_bytes);
+
+  // Appends a copy of the element.
+  void Add(absl::string_view element);
+
+  // Returns views of the elements in the order they were added. The views are
+  // invalidated by the next call to Add.
+  std::vector<absl::string_view> Views() const;
+
+  size_t size() const { return ends_.size(); }
+
+ private:
+  std::string bytes_;
+  // The end of each element in bytes_.
+  std::vector<size_t> ends_;
+};
+
+// A hash table over the server elements that several threads can fill and
+// take matches from at once without locks, so that each client element can be
+// matched as soon as it is re-encrypted rather than after the whole set is.
+// Taking follows the same multiset semantics as IntersectIndices: each
+// occurrence of a server element matches at most one client element.
+class ConcurrentElementTable {
+ public:
+  // Returns an empty table over the server elements, which must outlive it.
+  explicit ConcurrentElementTable(
+      const std::vector<absl::string_view>& server_elements);
+
+  ConcurrentElementTable(const ConcurrentElementTable&) = delete;
+  ConcurrentElementTable& operator=(const ConcurrentElementTable&) = delete;
+
+  // Adds the server element at the given position. May be called from several
+  // threads at once, but not while any thread calls Take.
+  void Insert(size_t position);
+
+  // Takes one occurrence of the element and returns true, or returns false if
+  // none is left. May be called from several threads at once once all server
+  // elements are inserted.
+  bool Take(absl::string_view element);
+
+ private:
+  struct Slot {
+    // 0 for an empty slot, or the high 32 bits of the hash of the element
+    // followed by its position plus one, published by a single CAS.
+    std::atomic<uint64_t> state{0};
+    // The occurrences of the element not taken yet.
+    std::atomic<uint32_t> count{0};
+  };
+
+  // Returns whether the state of a slot holds the element.
+  bool Matches(uint64_t state, uint64_t hash, absl::string_view element) const;
+
+  // Returns the slot of the element, or the empty slot where it belongs.
+  Slot* Find(uint64_t hash, absl::string_view element) const;
+
+  const std::vector<absl::string_view>& server_elements_;
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+};
+
+// Returns the engine with the given name, which is "sort_merge" or
+// "hash_join".
+//
+// Fails with INVALID_ARGUMENT for any other name.
+util::StatusOr<IntersectionEngine> ParseIntersectionEngine(
+    absl::string_view name);
+
+// Returns the indices of the client elements that are matched by a server
+// element, in unspecified order.
+//
+// server_elements_sorted states that the server elements are already in
+// increasing order, so that the sort-merge engine only sorts the client
+// elements. The claim is checked in one linear pass, and the server elements
+// are sorted anyway if it is wrong.
+std::vector<size_t> IntersectIndices(
+    IntersectionEngine engine,
+    const std::vector<absl::string_view>& client_elements,
+    const std::vector<absl::string_view>& server_elements,
+    bool server_elements_sorted);
+
+// Receives the worker that found some matches, in [0, num_threads), and the
+// indices of the matched client elements.
+using PartitionMatchCallback =
+    std::function<void(int worker, const std::vector<size_t>& matches)>;
+
+// Computes the same intersection as IntersectIndices, but first scatters both
+// sides into 2^radix_bits buckets by the leading bits of the hashes of their
+// elements, so that equal elements land in the same bucket. Each pair of
+// buckets is then intersected with the engine on its own, and small enough
+// buckets stay in the cache. The elements keep their order within each
+// bucket, so sorted server elements stay sorted.
+//
+// The pairs of buckets are shared among num_threads workers, the first of
+// which runs on the calling thread. Each worker calls on_matches on its own
+// thread once per bucket with matches, so on_matches must only touch state
+// owned by that worker.
+//
+// radix_bits must be in [0, 16] and num_threads must be positive.
+void PartitionedIntersectIndices(
+    IntersectionEngine engine,
+    const std::vector<absl::string_view>& client_elements,
+    const std::vector<absl::string_view>& server_elements,
+    bool server_elements_sorted, int radix_bits, int num_threads,
+    const PartitionMatchCallback& on_matches);
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_INTERSECTION_H_
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "key_pool.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "crypto/context.h"
+#include "util/status.inc"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// Published key files are named
+// "<kKeyFilePrefix><modulus_size>-<prime type>-<unique suffix><kKeyFileSuffix>".
+// In-flight and taken files start with '.', so they never match.
+static const char kKeyFilePrefix[] = "paillier-";
+static const char kKeyFileSuffix[] = ".key";
+static const char kTemporaryFilePrefix[] = ".tmp-";
+static const char kTakenFilePrefix[] = ".taken-";
+
+std::string PrimeTypeName(PaillierPrimeType prime_type) {
+  return prime_type == PaillierPrimeType::kSafePrimes ? "safe" : "primes";
+}
+
+// Returns the prefix shared by the names of all the keys with the given
+// parameters.
+std::string KeyFilePrefix(int32_t modulus_size, PaillierPrimeType prime_type) {
+  return absl::StrCat(kKeyFilePrefix, modulus_size, "-",
+                      PrimeTypeName(prime_type), "-");
+}
+
+// Writes all the bytes to the file descriptor, or returns false.
+bool WriteAll(int fd, const std::string& bytes) {
+  size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t result = write(fd, bytes.data() + written, bytes.size() - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
+
+// Reads the whole file behind the file descriptor, or returns false.
+bool ReadAll(int fd, std::string* bytes) {
+  char buffer[4096];
+  while (true) {
+    ssize_t result = read(fd, buffer, sizeof(buffer));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (result == 0) {
+      return true;
+    }
+    bytes->append(buffer, result);
+  }
+}
+
+// Returns a string that is unique across the processes sharing a pool.
+std::string UniqueSuffix() {
+  static std::atomic<int64_t> counter(0);
+  return absl::StrCat(
+      getpid(), "-",
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count(),
+      "-", counter++);
+}
+
+std::string JoinPath(absl::string_view dir, absl::string_view name) {
+  return absl::StrCat(dir, "/", name);
+}
+
+// Lists the names of the published keys with the given parameters.
+util::StatusOr<std::vector<std::string>> ListKeyFiles(
+    absl::string_view key_pool_dir, int32_t modulus_size,
+    PaillierPrimeType prime_type) {
+  DIR* dir = opendir(std::string(key_pool_dir).c_str());
+  if (dir == nullptr) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "ListKeyFiles: Couldn't open key pool directory: ", key_pool_dir));
+  }
+  std::string prefix = KeyFilePrefix(modulus_size, prime_type);
+  std::vector<std::string> names;
+  for (struct dirent* entry = readdir(dir); entry != nullptr;
+       entry = readdir(dir)) {
+    absl::string_view name(entry->d_name);
+    if (absl::StartsWith(name, prefix) && absl::EndsWith(name, kKeyFileSuffix)) {
+      names.emplace_back(name);
+    }
+  }
+  closedir(dir);
+  return names;
+}
+
+}  // namespace
+
+PaillierKey GeneratePaillierKey(Context* ctx, int32_t modulus_size,
+                                PaillierPrimeType prime_type) {
+  PaillierKey key;
+  for (std::string* prime : {key.mutable_p(), key.mutable_q()}) {
+    *prime = (prime_type == PaillierPrimeType::kSafePrimes
+                  ? ctx->GenerateSafePrime(modulus_size / 2)
+                  : ctx->GeneratePrime(modulus_size / 2))
+                 .ToBytes();
+  }
+  key.set_safe_primes(prime_type == PaillierPrimeType::kSafePrimes);
+  key.set_modulus_size(modulus_size);
+  return key;
+}
+
+util::Status AddKeyToPool(const PaillierKey& key,
+                          absl::string_view key_pool_dir) {
+  std::string suffix = UniqueSuffix();
+  std::string temporary_path =
+      JoinPath(key_pool_dir, absl::StrCat(kTemporaryFilePrefix, suffix));
+
+  // Write the key where no consumer looks for it. The file is only ever
+  // readable by its owner, and O_EXCL refuses to follow a planted link.
+  int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "AddKeyToPool: Couldn't open key file: ", temporary_path));
+  }
+  std::string serialized_key = key.SerializeAsString();
+  bool written = WriteAll(fd, serialized_key);
+  if (close(fd) != 0 || !written) {
+    std::remove(temporary_path.c_str());
+    return util::InternalError(absl::StrCat(
+        "AddKeyToPool: Couldn't write to or close key file: ", temporary_path));
+  }
+
+  // Publish it with a single rename, so consumers never see a partial key.
+  std::string key_path = JoinPath(
+      key_pool_dir,
+      absl::StrCat(KeyFilePrefix(key.modulus_size(),
+                                 key.safe_primes()
+                                     ? PaillierPrimeType::kSafePrimes
+                                     : PaillierPrimeType::kPrimes),
+                   suffix, kKeyFileSuffix));
+  if (std::rename(temporary_path.c_str(), key_path.c_str()) != 0) {
+    std::remove(temporary_path.c_str());
+    return util::InternalError(
+        absl::StrCat("AddKeyToPool: Couldn't publish key file: ", key_path));
+  }
+
+  return util::OkStatus();
+}
+
+util::StatusOr<int64_t> CountKeysInPool(absl::string_view key_pool_dir,
+                                        int32_t modulus_size,
+                                        PaillierPrimeType prime_type) {
+  auto maybe_names = ListKeyFiles(key_pool_dir, modulus_size, prime_type);
+  if (!maybe_names.ok()) {
+    return maybe_names.status();
+  }
+  return static_cast<int64_t>(maybe_names.ValueOrDie().size());
+}
+
+util::StatusOr<PaillierKey> TakeKeyFromPool(absl::string_view key_pool_dir,
+                                            int32_t modulus_size,
+                                            PaillierPrimeType prime_type) {
+  auto maybe_names = ListKeyFiles(key_pool_dir, modulus_size, prime_type);
+  if (!maybe_names.ok()) {
+    return maybe_names.status();
+  }
+
+  for (const std::string& name : maybe_names.ValueOrDie()) {
+    // Claim the key by moving it out of sight. Only one of several racing
+    // consumers can succeed; the others see it vanish and try the next one.
+    std::string key_path = JoinPath(key_pool_dir, name);
+    std::string taken_path =
+        JoinPath(key_pool_dir, absl::StrCat(kTakenFilePrefix, UniqueSuffix()));
+    if (std::rename(key_path.c_str(), taken_path.c_str()) != 0) {
+      continue;
+    }
+
+    // A key planted by another user would let them decrypt everything the
+    // client sends, so only private files of this user are trusted.
+    int fd = open(taken_path.c_str(), O_RDONLY | O_NOFOLLOW);
+    struct stat file_stat;
+    bool trusted = fd >= 0 && fstat(fd, &file_stat) == 0 &&
+                   S_ISREG(file_stat.st_mode) &&
+                   file_stat.st_uid == geteuid() &&
+                   (file_stat.st_mode & 077) == 0;
+    std::string serialized_key;
+    bool read = trusted && ReadAll(fd, &serialized_key);
+    if (fd >= 0) {
+      close(fd);
+    }
+    std::remove(taken_path.c_str());
+    if (!trusted) {
+      return util::InternalError(absl::StrCat(
+          "TakeKeyFromPool: Key file is not private to this user: ",
+          key_path));
+    }
+    PaillierKey key;
+    if (!read || !key.ParseFromString(serialized_key) || !key.has_p() ||
+        !key.has_q() || key.modulus_size() != modulus_size ||
+        key.safe_primes() != (prime_type == PaillierPrimeType::kSafePrimes)) {
+      return util::InternalError(
+          absl::StrCat("TakeKeyFromPool: Corrupt key file: ", key_path));
+    }
+    return key;
+  }
+
+  return util::NotFoundError(absl::StrCat(
+      "TakeKeyFromPool: No ", modulus_size, "-bit key of prime type \"",
+      PrimeTypeName(prime_type), "\" in ", key_pool_dir));
+}
+
+}  // namespace private_join_and_compute
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_KEY_POOL_H_
+#define OPEN_SOURCE_KEY_POOL_H_
+
+// Contains utility functions to maintain a pool of pre-generated Paillier keys
+// in a local directory, so that a client can start the protocol without first
+// waiting for prime generation.
+//
+// Each key is stored in its own file. Keys are published by writing a hidden
+// temporary file and renaming it into place, and consumed by renaming the file
+// to a hidden name before reading it, so several producers and consumers may
+// share a pool directory and no key is ever handed out twice.
+//
+// Key files are created readable by their owner only, but anyone who can list
+// and rename files in the pool directory can take keys from it, so the
+// directory must be private to the user running the producers and consumers,
+// e.g. created with mode 0700. Consumers refuse key files that another user
+// owns or could have read.
+
+#include <string>
+
+#include "crypto/context.h"
+#include "crypto/paillier.h"
+#include "match.pb.h"
+#include "util/status.inc"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+// Generates a fresh Paillier key whose modulus has modulus_size bits, formed
+// from two primes of the given type.
+PaillierKey GeneratePaillierKey(Context* ctx, int32_t modulus_size,
+                                PaillierPrimeType prime_type);
+
+// Atomically adds the key to the pool in key_pool_dir, which must exist.
+//
+// Fails with INVALID_ARGUMENT if the key file could not be created, and with
+// INTERNAL if it could not be written or published.
+util::Status AddKeyToPool(const PaillierKey& key,
+                          absl::string_view key_pool_dir);
+
+// Returns the number of keys in the pool with the given modulus size and prime
+// type.
+//
+// Fails with INVALID_ARGUMENT if key_pool_dir cannot be read.
+util::StatusOr<int64_t> CountKeysInPool(absl::string_view key_pool_dir,
+                                        int32_t modulus_size,
+                                        PaillierPrimeType prime_type);
+
+// Atomically removes a key with the given modulus size and prime type from the
+// pool and returns it. The key is deleted from disk, so it will not be returned
+// again by this or any other process.
+//
+// Fails with NOT_FOUND if the pool holds no such key, with INVALID_ARGUMENT if
+// key_pool_dir cannot be read, and with INTERNAL if the taken key file is not
+// owned by this user, is accessible to others, is corrupt or holds a key with
+// other parameters than its name says.
+util::StatusOr<PaillierKey> TakeKeyFromPool(absl::string_view key_pool_dir,
+                                            int32_t modulus_size,
+                                            PaillierPrimeType prime_type);
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_KEY_POOL_H_
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tool to fill a directory with pre-generated Paillier keys for the client in
+// Private Join and Compute. Left running with --refill_interval_seconds, it
+// keeps the pool topped up in the background as clients consume keys.
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "gflags/gflags.h"
+
+#include "glog/logging.h"
+#include "crypto/context.h"
+#include "key_pool.h"
+
+DEFINE_string(key_pool_dir, "",
+              "The existing directory in which to store the generated keys.");
+DEFINE_int64(key_pool_size, 8,
+             "Number of keys of the requested kind to keep in the pool.");
+DEFINE_int32(paillier_modulus_size, 1536,
+             "The bit-length of the Paillier modulus of the generated keys.");
+DEFINE_bool(paillier_safe_primes, true,
+            "Whether the generated keys are made of safe primes.");
+DEFINE_int32(refill_interval_seconds, 0,
+             "If positive, keep running and check the pool size this often. "
+             "Otherwise exit once the pool is full.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  ::private_join_and_compute::Context context;
+  ::private_join_and_compute::PaillierPrimeType prime_type =
+      FLAGS_paillier_safe_primes
+          ? ::private_join_and_compute::PaillierPrimeType::kSafePrimes
+          : ::private_join_and_compute::PaillierPrimeType::kPrimes;
+
+  while (true) {
+    auto maybe_pool_size = ::private_join_and_compute::CountKeysInPool(
+        FLAGS_key_pool_dir, FLAGS_paillier_modulus_size, prime_type);
+    if (!maybe_pool_size.ok()) {
+      std::cerr << "PaillierKeyPool: Error reading the key pool: "
+                << maybe_pool_size.status() << std::endl;
+      return 1;
+    }
+
+    for (int64_t i = maybe_pool_size.ValueOrDie(); i < FLAGS_key_pool_size;
+         i++) {
+      auto add_status = ::private_join_and_compute::AddKeyToPool(
+          ::private_join_and_compute::GeneratePaillierKey(
+              &context, FLAGS_paillier_modulus_size, prime_type),
+          FLAGS_key_pool_dir);
+      if (!add_status.ok()) {
+        std::cerr << "PaillierKeyPool: Error adding a key to the pool: "
+                  << add_status << std::endl;
+        return 1;
+      }
+      std::cout << "Added key " << i + 1 << "/" << FLAGS_key_pool_size
+                << " to " << FLAGS_key_pool_dir << std::endl;
+    }
+
+    if (FLAGS_refill_interval_seconds <= 0) {
+      return 0;
+    }
+    std::this_thread::sleep_for(
+        std::chrono::seconds(FLAGS_refill_interval_seconds));
+  }
+}
@@ -41,7 +41,8 @@ namespace {
 ::grpc::Status PrivateJoinAndComputeRpcImpl::StartProtocol(
     ::grpc::ServerContext* context, const StartProtocolRequest* request,
     ServerRoundOne* response) {
-  auto maybe_response = server_->EncryptSet();
+  auto maybe_response = server_->EncryptSet(request->sampling_rate(),
+                                            request->sampling_salt_share());
   if (maybe_response.ok()) {
     *response = std::move(maybe_response.ValueOrDie());
   }
@@ -65,4 +66,31 @@ namespace {
   return ConvertStatus(maybe_response.status());
 }
 
+::grpc::Status PrivateJoinAndComputeRpcImpl::GetFilter(
+    ::grpc::ServerContext* context, const GetFilterRequest* request,
+    ServerFilter* response) {
+  auto maybe_response = server_->GetFilter();
+  if (maybe_response.ok()) {
+    *response = std::move(maybe_response.ValueOrDie());
+  }
+  return ConvertStatus(maybe_response.status());
+}
+
+::grpc::Status PrivateJoinAndComputeRpcImpl::ExecuteUnbalancedRound(
+    ::grpc::ServerContext* context, const UnbalancedClientRoundOne* request,
+    UnbalancedServerRoundOne* response) {
+  if (protocol_finished_) {
+    return ::grpc::Status(
+        ::grpc::StatusCode::INVALID_ARGUMENT,
+        "PrivateJoinAndComputeRpcImpl: Protocol is already finished.");
+  }
+
+  auto maybe_response = server_->ReEncryptUnbalancedSet(*request);
+  if (maybe_response.ok()) {
+    *response = std::move(maybe_response.ValueOrDie());
+    protocol_finished_ = true;
+  }
+  return ConvertStatus(maybe_response.status());
+}
+
 }  // namespace private_join_and_compute
@@ -43,6 +43,17 @@ class PrivateJoinAndComputeRpcImpl : public PrivateJoinAndComputeRpc::Service {
                                        const ClientRoundOne* request,
                                        ServerRoundTwo* response) override;
 
+  // Returns the server's filter, for the unbalanced mode.
+  ::grpc::Status GetFilter(::grpc::ServerContext* context,
+                           const GetFilterRequest* request,
+                           ServerFilter* response) override;
+
+  // Executes the only round of the unbalanced mode, and marks the protocol as
+  // finished if the step succeeded.
+  ::grpc::Status ExecuteUnbalancedRound(
+      ::grpc::ServerContext* context, const UnbalancedClientRoundOne* request,
+      UnbalancedServerRoundOne* response) override;
+
   bool protocol_finished() const { return protocol_finished_; }
 
  private:
@@ -13,6 +13,11 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -35,6 +40,59 @@
 DEFINE_string(port, "0.0.0.0:10501", "Port on which to listen");
 DEFINE_string(server_data_file, "",
               "The file from which to read the server database.");
+DEFINE_string(filter_key_file, "",
+              "If set, the file holding the filter key of the unbalanced mode, "
+              "so that the filters kept by clients stay valid across runs of "
+              "the server. A new key is written to it if it does not exist.");
+DEFINE_bool(precompute_filter, false,
+            "Whether to build the filter of the unbalanced mode before "
+            "listening, rather than on the first request for it.");
+
+// Makes the server use the key in --filter_key_file, or writes the server's
+// new filter key to it if it does not exist.
+bool LoadOrSaveFilterKey(::private_join_and_compute::Server* server) {
+  std::ifstream key_in(FLAGS_filter_key_file, std::ios::binary);
+  if (key_in.is_open()) {
+    std::string key_bytes((std::istreambuf_iterator<char>(key_in)),
+                          std::istreambuf_iterator<char>());
+    auto status = server->SetFilterKey(key_bytes);
+    if (!status.ok()) {
+      std::cerr << "RunServer: failed to SetFilterKey: " << status
+                << std::endl;
+      return false;
+    }
+    return true;
+  }
+  auto maybe_key_bytes = server->GetFilterKey();
+  if (!maybe_key_bytes.ok()) {
+    std::cerr << "RunServer: failed to GetFilterKey: "
+              << maybe_key_bytes.status() << std::endl;
+    return false;
+  }
+  // The key is secret, so the file is created readable by its owner only, and
+  // never through an existing file or symlink.
+  const std::string& key_bytes = maybe_key_bytes.ValueOrDie();
+  int fd = open(FLAGS_filter_key_file.c_str(), O_WRONLY | O_CREAT | O_EXCL,
+                0600);
+  size_t written = 0;
+  while (fd >= 0 && written < key_bytes.size()) {
+    ssize_t result =
+        write(fd, key_bytes.data() + written, key_bytes.size() - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    written += result;
+  }
+  if (fd < 0 || close(fd) != 0 || written < key_bytes.size()) {
+    std::cerr << "RunServer: failed to write " << FLAGS_filter_key_file
+              << std::endl;
+    return false;
+  }
+  return true;
+}
 
 int RunServer() {
   std::cout << "Server: loading data... " << std::endl;
@@ -50,6 +108,19 @@ int RunServer() {
   std::unique_ptr<::private_join_and_compute::Server> server =
       absl::make_unique<::private_join_and_compute::Server>(
           &context, std::move(maybe_server_identifiers.ValueOrDie()));
+  if (!FLAGS_filter_key_file.empty() && !LoadOrSaveFilterKey(server.get())) {
+    return 1;
+  }
+  if (FLAGS_precompute_filter) {
+    std::cout << "Server: building the filter of the unbalanced mode... "
+              << std::endl;
+    auto maybe_filter = server->GetFilter();
+    if (!maybe_filter.ok()) {
+      std::cerr << "RunServer: failed to GetFilter: " << maybe_filter.status()
+                << std::endl;
+      return 1;
+    }
+  }
   ::private_join_and_compute::PrivateJoinAndComputeRpcImpl service(std::move(server));
 
   ::grpc::ServerBuilder builder;
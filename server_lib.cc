@@ -16,10 +16,52 @@
 #include "server_lib.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>  // NOLINT
 
+#include "gflags/gflags.h"
 #include "crypto/paillier.h"
 #include "crypto/ec_commutative_cipher.h"
+#include "element_filter.h"
+#include "external_intersection.h"
+#include "fingerprint.h"
+#include "intersection.h"
+#include "set_sampling.h"
+#include "sorted_set_codec.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+DEFINE_string(intersection_engine, "hash_join",
+              "The algorithm matching the doubly encrypted sets of the two "
+              "parties: sort_merge or hash_join.");
+DEFINE_int32(intersection_radix_bits, 0,
+             "If positive, the server scatters both doubly encrypted sets into "
+             "2^k buckets and intersects each pair of buckets on its own. "
+             "At most 16.");
+DEFINE_int32(intersection_threads, 1,
+             "The number of threads intersecting the pairs of buckets and "
+             "summing the matched ciphertexts, if --intersection_radix_bits "
+             "is positive.");
+DEFINE_bool(intersection_streaming, false,
+            "Whether the server matches each element of the client's set as "
+            "soon as it is re-encrypted, in a concurrent hash table over the "
+            "client's re-encryption of the server's set, and adds its "
+            "ciphertext to the sum right away. Uses --intersection_threads "
+            "threads, and ignores --intersection_engine and "
+            "--intersection_radix_bits.");
+DEFINE_int64(intersection_memory_budget_mb, 0,
+             "If positive, the server intersects out of core: it spills its "
+             "re-encryption of the client's set to sorted runs in "
+             "--intersection_temp_dir whenever they use more than this many "
+             "MiB, and merges the runs with the client's sorted re-encryption "
+             "of the server's set. At most 256 runs are open at once; more "
+             "runs take extra merge passes.");
+DEFINE_string(intersection_temp_dir, "/tmp",
+              "The directory of the runs of the out-of-core intersection.");
+DEFINE_double(filter_false_positive_rate, 1e-6,
+              "The probability that the filter of the unbalanced mode reports "
+              "a client element that is not in the server's set.");
 
 using ::private_join_and_compute::BigNum;
 using ::private_join_and_compute::Context;
@@ -29,6 +71,367 @@ using ::util::StatusOr;
 
 namespace private_join_and_compute {
 
+namespace {
+
+// The number of elements a worker of the streaming intersection claims at a
+// time.
+const int kStreamingChunkSize = 64;
+
+// The label whose encryption with the filter key identifies that key.
+const char kFilterKeyCheckLabel[] = "ServerFilter key check";
+
+// Returns the server's re-encryption of an element of the client's set, or its
+// fingerprint if the client sent fingerprints.
+StatusOr<std::string> ReEncryptClientElement(
+    Context* ctx, ECCommutativeCipher* ec_cipher,
+    const ClientRoundOne& client_message, const std::string& element) {
+  StatusOr<std::string> reenc = ec_cipher->ReEncrypt(element);
+  if (!reenc.ok() || client_message.fingerprint_bytes() == 0) {
+    return reenc;
+  }
+  return Fingerprint(ctx, reenc.ValueOrDie(),
+                     client_message.fingerprint_bytes());
+}
+
+// Returns the total size of the elements of the set. Reservations are sized
+// by it rather than by the size of one element, so they never exceed what the
+// client actually sent.
+size_t TotalElementBytes(const EncryptedSet& set) {
+  size_t total = 0;
+  for (const EncryptedElement& element : set.elements()) {
+    total += element.element().size();
+  }
+  return total;
+}
+
+// Packs the client's re-encryption of the server's set, decoding it if it is
+// compressed, and sets *sorted to whether the client claims it is sorted.
+util::Status UnpackServerSet(const ClientRoundOne& client_message,
+                             PackedElements* server_set, bool* sorted) {
+  *sorted = client_message.reencrypted_set_sorted();
+  if (client_message.has_reencrypted_set_compressed()) {
+    StatusOr<std::unique_ptr<SortedSetDecoder>> maybe_decoder =
+        SortedSetDecoder::Create(client_message.reencrypted_set_compressed());
+    if (!maybe_decoder.ok()) {
+      return maybe_decoder.status();
+    }
+    SortedSetDecoder& decoder = *maybe_decoder.ValueOrDie();
+    server_set->Reserve(decoder.size(),
+                        decoder.size() * decoder.element_size());
+    while (decoder.Next()) {
+      server_set->Add(decoder.element());
+    }
+    *sorted = true;
+    return decoder.status();
+  }
+  const auto& server_reencrypted_set =
+      client_message.reencrypted_set().elements();
+  server_set->Reserve(server_reencrypted_set.size(),
+                      TotalElementBytes(client_message.reencrypted_set()));
+  for (const EncryptedElement& element : server_reencrypted_set) {
+    server_set->Add(element.element());
+  }
+  return util::OkStatus();
+}
+
+// Matches the re-encryption of the client's set with the client's
+// re-encryption of the server's set in memory, with the engine selected by the
+// flags, and adds the ciphertexts of the matched associated values to *sum.
+// Returns the size of the intersection.
+StatusOr<size_t> SumIntersectionInMemory(Context* ctx,
+                                         ECCommutativeCipher* ec_cipher,
+                                         const ClientRoundOne& client_message,
+                                         const PublicPaillier& public_paillier,
+                                         BigNum* sum) {
+  StatusOr<IntersectionEngine> engine =
+      ParseIntersectionEngine(FLAGS_intersection_engine);
+  if (!engine.ok()) {
+    return engine.status();
+  }
+
+  // First, we re-encrypt the client party's set, so that we can compare with
+  // the re-encrypted set received from the client. The matching only sees the
+  // packed keys of both sets; the matches are the indices into
+  // client_encrypted_set, whose associated data is only read when summing.
+  const auto& client_encrypted_set = client_message.encrypted_set().elements();
+  PackedElements client_set;
+  PackedElements server_set;
+  // A re-encrypted point or its fingerprint is never longer than the point
+  // the client sent.
+  client_set.Reserve(client_encrypted_set.size(),
+                     TotalElementBytes(client_message.encrypted_set()));
+  for (const EncryptedElement& element : client_encrypted_set) {
+    StatusOr<std::string> reenc = ReEncryptClientElement(
+        ctx, ec_cipher, client_message, element.element());
+    if (!reenc.ok()) {
+      return reenc.status();
+    }
+    client_set.Add(reenc.ValueOrDie());
+  }
+  bool server_set_sorted = false;
+  util::Status status =
+      UnpackServerSet(client_message, &server_set, &server_set_sorted);
+  if (!status.ok()) {
+    return status;
+  }
+  std::vector<absl::string_view> client_elements = client_set.Views();
+  std::vector<absl::string_view> server_elements = server_set.Views();
+
+  // From the intersection we compute the sum of the associated values, which is
+  // the result we return to the client. Each worker sums the ciphertexts of
+  // its matches in its own Context, since Contexts cannot be shared between
+  // threads, and the partial sums are added up at the end.
+  const int radix_bits = FLAGS_intersection_radix_bits;
+  const int num_workers = radix_bits > 0 ? FLAGS_intersection_threads : 1;
+  if (radix_bits < 0 || radix_bits > 16 || num_workers < 1) {
+    return util::InvalidArgumentError(
+        "ComputeIntersection: --intersection_radix_bits must be in [0, 16] "
+        "and --intersection_threads must be positive.");
+  }
+  std::vector<std::unique_ptr<Context>> worker_contexts;
+  std::vector<BigNum> partial_sums;
+  for (int worker = 0; worker < num_workers; worker++) {
+    Context* worker_ctx = ctx;
+    if (worker > 0) {
+      worker_contexts.push_back(absl::make_unique<Context>());
+      worker_ctx = worker_contexts.back().get();
+    }
+    partial_sums.push_back(worker_ctx->CreatePublicBigNum(1));
+  }
+  std::vector<size_t> partial_sizes(num_workers, 0);
+  auto add_matches = [&](int worker, const std::vector<size_t>& matches) {
+    BigNumArena worker_arena;
+    BigNum ciphertext = partial_sums[worker];
+    for (size_t index : matches) {
+      ParseInto(client_encrypted_set[index].associated_data(), &ciphertext);
+      public_paillier.AddInPlace(&partial_sums[worker], ciphertext);
+    }
+    partial_sizes[worker] += matches.size();
+  };
+  if (radix_bits > 0) {
+    PartitionedIntersectIndices(
+        engine.ValueOrDie(), client_elements, server_elements,
+        server_set_sorted, radix_bits, num_workers,
+        add_matches);
+  } else {
+    add_matches(0, IntersectIndices(engine.ValueOrDie(), client_elements,
+                                    server_elements, server_set_sorted));
+  }
+
+  size_t intersection_size = 0;
+  for (int worker = 0; worker < num_workers; worker++) {
+    public_paillier.AddInPlace(sum, partial_sums[worker]);
+    intersection_size += partial_sizes[worker];
+  }
+  return intersection_size;
+}
+
+// Runs work(worker) for each worker in [0, num_workers), the first on the
+// calling thread, and waits for all of them.
+void RunWorkers(int num_workers, const std::function<void(int)>& work) {
+  std::vector<std::thread> threads;
+  for (int worker = 1; worker < num_workers; worker++) {
+    threads.emplace_back(work, worker);
+  }
+  work(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+// Same as SumIntersectionInMemory, but overlaps the re-encryption of the
+// client's set, the matching and the summing. The client's re-encryption of
+// the server's set, which needs no EC work, fills a concurrent hash table
+// first. The workers then claim chunks of the client's set, re-encrypt each
+// element with their own copy of the cipher, take it from the table and add
+// its ciphertext to their partial sum, so that the client's re-encryption is
+// never stored.
+StatusOr<size_t> SumIntersectionStreaming(Context* ctx,
+                                          ECCommutativeCipher* ec_cipher,
+                                          const ClientRoundOne& client_message,
+                                          const PublicPaillier& public_paillier,
+                                          BigNum* sum) {
+  const int num_workers = FLAGS_intersection_threads;
+  if (num_workers < 1) {
+    return util::InvalidArgumentError(
+        "ComputeIntersection: --intersection_threads must be positive.");
+  }
+  PackedElements server_set;
+  bool server_set_sorted;
+  util::Status status =
+      UnpackServerSet(client_message, &server_set, &server_set_sorted);
+  if (!status.ok()) {
+    return status;
+  }
+  std::vector<absl::string_view> server_elements = server_set.Views();
+  ConcurrentElementTable table(server_elements);
+
+  // Each worker has its own Context and cipher, since neither can be shared
+  // between threads.
+  std::vector<std::unique_ptr<Context>> worker_contexts;
+  std::vector<std::unique_ptr<ECCommutativeCipher>> worker_ciphers;
+  std::vector<BigNum> partial_sums;
+  for (int worker = 0; worker < num_workers; worker++) {
+    Context* worker_ctx = ctx;
+    if (worker > 0) {
+      worker_contexts.push_back(absl::make_unique<Context>());
+      worker_ctx = worker_contexts.back().get();
+      StatusOr<std::unique_ptr<ECCommutativeCipher>> worker_cipher =
+          ECCommutativeCipher::CreateFromKey(NID_secp224r1,
+                                             ec_cipher->GetPrivateKeyBytes());
+      if (!worker_cipher.ok()) {
+        return worker_cipher.status();
+      }
+      worker_ciphers.push_back(std::move(worker_cipher.ValueOrDie()));
+    }
+    partial_sums.push_back(worker_ctx->CreatePublicBigNum(1));
+  }
+
+  std::atomic<size_t> next_chunk(0);
+  const size_t num_server_chunks =
+      (server_elements.size() + kStreamingChunkSize - 1) / kStreamingChunkSize;
+  RunWorkers(num_workers, [&](int worker) {
+    for (size_t chunk = next_chunk++; chunk < num_server_chunks;
+         chunk = next_chunk++) {
+      size_t end = std::min(server_elements.size(),
+                            (chunk + 1) * kStreamingChunkSize);
+      for (size_t i = chunk * kStreamingChunkSize; i < end; i++) {
+        table.Insert(i);
+      }
+    }
+  });
+
+  const auto& client_encrypted_set = client_message.encrypted_set().elements();
+  const size_t num_client_chunks =
+      (client_encrypted_set.size() + kStreamingChunkSize - 1) /
+      kStreamingChunkSize;
+  std::vector<size_t> partial_sizes(num_workers, 0);
+  std::vector<util::Status> worker_statuses(num_workers);
+  std::atomic<bool> failed(false);
+  next_chunk = 0;
+  RunWorkers(num_workers, [&](int worker) {
+    BigNumArena worker_arena;
+    Context* worker_ctx = worker == 0 ? ctx : worker_contexts[worker - 1].get();
+    ECCommutativeCipher* worker_cipher =
+        worker == 0 ? ec_cipher : worker_ciphers[worker - 1].get();
+    BigNum ciphertext = partial_sums[worker];
+    for (size_t chunk = next_chunk++; chunk < num_client_chunks && !failed;
+         chunk = next_chunk++) {
+      size_t end = std::min<size_t>(client_encrypted_set.size(),
+                                    (chunk + 1) * kStreamingChunkSize);
+      for (size_t i = chunk * kStreamingChunkSize; i < end; i++) {
+        StatusOr<std::string> reenc =
+            ReEncryptClientElement(worker_ctx, worker_cipher, client_message,
+                                   client_encrypted_set[i].element());
+        if (!reenc.ok()) {
+          worker_statuses[worker] = reenc.status();
+          failed = true;
+          return;
+        }
+        if (table.Take(reenc.ValueOrDie())) {
+          ParseInto(client_encrypted_set[i].associated_data(), &ciphertext);
+          public_paillier.AddInPlace(&partial_sums[worker], ciphertext);
+          partial_sizes[worker]++;
+        }
+      }
+    }
+  });
+
+  size_t intersection_size = 0;
+  for (int worker = 0; worker < num_workers; worker++) {
+    if (!worker_statuses[worker].ok()) {
+      return worker_statuses[worker];
+    }
+    public_paillier.AddInPlace(sum, partial_sums[worker]);
+    intersection_size += partial_sizes[worker];
+  }
+  return intersection_size;
+}
+
+// Same as SumIntersectionInMemory, but keeps at most
+// --intersection_memory_budget_mb of the re-encryption of the client's set in
+// memory and spills the rest to disk. The client's re-encryption of the
+// server's set must be sorted, as sent by Client::ReEncryptSet.
+StatusOr<size_t> SumIntersectionOutOfCore(
+    Context* ctx, ECCommutativeCipher* ec_cipher,
+    const ClientRoundOne& client_message,
+    const PublicPaillier& public_paillier, BigNum* sum) {
+  StatusOr<std::unique_ptr<ExternalIntersection>> maybe_intersection =
+      ExternalIntersection::Create(
+          FLAGS_intersection_temp_dir,
+          static_cast<size_t>(FLAGS_intersection_memory_budget_mb) << 20);
+  if (!maybe_intersection.ok()) {
+    return maybe_intersection.status();
+  }
+  ExternalIntersection& intersection = *maybe_intersection.ValueOrDie();
+
+  const auto& client_encrypted_set = client_message.encrypted_set().elements();
+  for (int i = 0; i < client_encrypted_set.size(); i++) {
+    StatusOr<std::string> reenc = ReEncryptClientElement(
+        ctx, ec_cipher, client_message, client_encrypted_set[i].element());
+    if (!reenc.ok()) {
+      return reenc.status();
+    }
+    util::Status status =
+        intersection.AddClientElement(reenc.ValueOrDie(), i);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // A compressed re-encryption of the server's set is decoded as the merge
+  // reaches its elements, never as a whole.
+  const auto& server_reencrypted_set =
+      client_message.reencrypted_set().elements();
+  size_t num_server_elements = server_reencrypted_set.size();
+  ExternalIntersection::ServerElementFn server_element =
+      [&server_reencrypted_set](size_t position, absl::string_view* element) {
+        *element = server_reencrypted_set[position].element();
+        return true;
+      };
+  std::unique_ptr<SortedSetDecoder> decoder;
+  size_t num_decoded = 0;
+  if (client_message.has_reencrypted_set_compressed()) {
+    StatusOr<std::unique_ptr<SortedSetDecoder>> maybe_decoder =
+        SortedSetDecoder::Create(client_message.reencrypted_set_compressed());
+    if (!maybe_decoder.ok()) {
+      return maybe_decoder.status();
+    }
+    decoder = std::move(maybe_decoder.ValueOrDie());
+    num_server_elements = decoder->size();
+    server_element = [&decoder, &num_decoded](size_t position,
+                                              absl::string_view* element) {
+      while (num_decoded <= position) {
+        if (!decoder->Next()) {
+          return false;
+        }
+        num_decoded++;
+      }
+      *element = decoder->element();
+      return true;
+    };
+  }
+
+  // The matched ciphertexts are streamed into the sum as the merge finds them.
+  BigNum ciphertext = ctx->CreatePublicBigNum(0);
+  size_t intersection_size = 0;
+  util::Status status = intersection.Match(
+      num_server_elements, server_element, [&](size_t index) {
+        ParseInto(client_encrypted_set[index].associated_data(), &ciphertext);
+        public_paillier.AddInPlace(sum, ciphertext);
+        intersection_size++;
+      });
+  if (decoder != nullptr && !decoder->status().ok()) {
+    return decoder->status();
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return intersection_size;
+}
+
+}  // namespace
+
 Server::Server(Context* ctx, const std::vector<std::string>& inputs)
     : ctx_(ctx), inputs_(inputs) {}
 
@@ -40,12 +443,26 @@ Server::Server(Context* ctx, const std::string& serialized_state) : ctx_(ctx) {
         ECCommutativeCipher::CreateFromKey(NID_secp224r1, state.ec_key())
             .ValueOrDie());
   }
+  if (state.has_filter_ec_key()) {
+    filter_cipher_ = std::move(
+        ECCommutativeCipher::CreateFromKey(NID_secp224r1, state.filter_ec_key())
+            .ValueOrDie());
+  }
 }
 
-StatusOr<ServerRoundOne> Server::EncryptSet() {
+StatusOr<ServerRoundOne> Server::EncryptSet(
+    double sampling_rate, const std::string& client_salt_share) {
   if (ec_cipher_ != nullptr) {
     return util::InvalidArgumentError("Attempted to call EncryptSet twice.");
   }
+  if (sampling_rate <= 0 || sampling_rate > 1) {
+    return util::InvalidArgumentError(
+        "EncryptSet: The sampling rate must be in (0, 1].");
+  }
+  if (sampling_rate < 1 && client_salt_share.size() != kSamplingSaltBytes) {
+    return util::InvalidArgumentError(
+        "EncryptSet: The client's sampling salt share has the wrong size.");
+  }
   StatusOr<std::unique_ptr<ECCommutativeCipher>> ec_cipher =
       ECCommutativeCipher::CreateWithNewKey(NID_secp224r1);
   if (!ec_cipher.ok()) {
@@ -53,8 +470,21 @@ StatusOr<ServerRoundOne> Server::EncryptSet() {
   }
   ec_cipher_ = std::move(ec_cipher.ValueOrDie());
 
+  // Recycles the BIGNUMs of hashing each input to the curve.
+  BigNumArena arena;
   ServerRoundOne result;
+  std::string sampling_salt;
+  if (sampling_rate < 1) {
+    result.set_sampling_rate(sampling_rate);
+    *result.mutable_sampling_salt_share() =
+        ctx_->GenerateRandomBytes(kSamplingSaltBytes);
+    sampling_salt = DeriveSamplingSalt(ctx_, result.sampling_salt_share(),
+                                       client_salt_share);
+  }
   for (const std::string& input : inputs_) {
+    if (!InSample(ctx_, sampling_salt, input, sampling_rate)) {
+      continue;
+    }
     EncryptedElement* encrypted =
         result.mutable_encrypted_set()->add_elements();
     StatusOr<std::string> encrypted_element = ec_cipher_->Encrypt(input);
@@ -73,61 +503,145 @@ StatusOr<ServerRoundTwo> Server::ComputeIntersection(
     return util::InvalidArgumentError(
         "Called ComputeIntersection before EncryptSet.");
   }
-  ServerRoundTwo result;
-  BigNum N = ctx_->CreateBigNum(client_message.public_key());
-  PublicPaillier public_paillier(ctx_, N, 2);
-
-  std::vector<EncryptedElement> server_set, client_set, intersection;
-
-  // First, we re-encrypt the client party's set, so that we can compare with
-  // the re-encrypted set received from the client.
-  for (const EncryptedElement& element :
-       client_message.encrypted_set().elements()) {
-    EncryptedElement reencrypted;
-    *reencrypted.mutable_associated_data() = element.associated_data();
-    StatusOr<std::string> reenc = ec_cipher_->ReEncrypt(element.element());
-    if (!reenc.ok()) {
-      return reenc.status();
-    }
-    *reencrypted.mutable_element() = reenc.ValueOrDie();
-    client_set.push_back(reencrypted);
+  // Recycles the BIGNUMs of re-encrypting the client's set and of summing the
+  // intersection's ciphertexts.
+  BigNumArena arena;
+  // Clients that do not advertise s use s = 2.
+  int paillier_s =
+      client_message.has_paillier_s() ? client_message.paillier_s() : 2;
+  if (paillier_s < 1 || paillier_s > kMaxPaillierS) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "ComputeIntersection: paillier_s must be in [1, ", kMaxPaillierS,
+        "]."));
   }
-  for (const EncryptedElement& element :
-       client_message.reencrypted_set().elements()) {
-    server_set.push_back(element);
-  }
-
-  // std::set_intersection requires sorted inputs.
-  std::sort(client_set.begin(), client_set.end(),
-            [](const EncryptedElement& a, const EncryptedElement& b) {
-              return a.element() < b.element();
-            });
-  std::sort(server_set.begin(), server_set.end(),
-            [](const EncryptedElement& a, const EncryptedElement& b) {
-              return a.element() < b.element();
-            });
-  std::set_intersection(
-      client_set.begin(), client_set.end(), server_set.begin(),
-      server_set.end(), std::back_inserter(intersection),
-      [](const EncryptedElement& a, const EncryptedElement& b) {
-        return a.element() < b.element();
-      });
+  if (client_message.fingerprint_bytes() < 0 ||
+      client_message.fingerprint_bytes() > kMaxFingerprintBytes) {
+    return util::InvalidArgumentError(absl::StrCat(
+        "ComputeIntersection: fingerprint_bytes must be in [0, ",
+        kMaxFingerprintBytes, "]."));
+  }
+  ServerRoundTwo result;
+  BigNum N = ctx_->CreatePublicBigNum(client_message.public_key());
+  PublicPaillier public_paillier(ctx_, N, paillier_s);
 
-  // From the intersection we compute the sum of the associated values, which is
-  // the result we return to the client.
   StatusOr<BigNum> encrypted_zero =
       public_paillier.Encrypt(ctx_->CreateBigNum(0));
   if (!encrypted_zero.ok()) {
     return encrypted_zero.status();
   }
   BigNum sum = encrypted_zero.ValueOrDie();
-  for (const EncryptedElement& element : intersection) {
-    sum =
-        public_paillier.Add(sum, ctx_->CreateBigNum(element.associated_data()));
+  StatusOr<size_t> intersection_size =
+      FLAGS_intersection_memory_budget_mb > 0
+          ? SumIntersectionOutOfCore(ctx_, ec_cipher_.get(), client_message,
+                                     public_paillier, &sum)
+          : FLAGS_intersection_streaming
+                ? SumIntersectionStreaming(ctx_, ec_cipher_.get(),
+                                           client_message, public_paillier,
+                                           &sum)
+                : SumIntersectionInMemory(ctx_, ec_cipher_.get(),
+                                          client_message, public_paillier,
+                                          &sum);
+  if (!intersection_size.ok()) {
+    return intersection_size.status();
   }
 
   *result.mutable_encrypted_sum() = sum.ToBytes();
-  result.set_intersection_size(intersection.size());
+  result.set_intersection_size(intersection_size.ValueOrDie());
+  return result;
+}
+
+util::Status Server::CreateFilterCipherIfNeeded() {
+  if (filter_cipher_ != nullptr) {
+    return util::OkStatus();
+  }
+  StatusOr<std::unique_ptr<ECCommutativeCipher>> filter_cipher =
+      ECCommutativeCipher::CreateWithNewKey(NID_secp224r1);
+  if (!filter_cipher.ok()) {
+    return filter_cipher.status();
+  }
+  filter_cipher_ = std::move(filter_cipher.ValueOrDie());
+  return util::OkStatus();
+}
+
+util::Status Server::SetFilterKey(const std::string& key_bytes) {
+  if (filter_cipher_ != nullptr) {
+    return util::InvalidArgumentError("The filter key is already set.");
+  }
+  StatusOr<std::unique_ptr<ECCommutativeCipher>> filter_cipher =
+      ECCommutativeCipher::CreateFromKey(NID_secp224r1, key_bytes);
+  if (!filter_cipher.ok()) {
+    return filter_cipher.status();
+  }
+  filter_cipher_ = std::move(filter_cipher.ValueOrDie());
+  return util::OkStatus();
+}
+
+StatusOr<std::string> Server::GetFilterKey() {
+  util::Status status = CreateFilterCipherIfNeeded();
+  if (!status.ok()) {
+    return status;
+  }
+  return filter_cipher_->GetPrivateKeyBytes();
+}
+
+StatusOr<ServerFilter> Server::GetFilter() {
+  if (filter_ != nullptr) {
+    return *filter_;
+  }
+  util::Status status = CreateFilterCipherIfNeeded();
+  if (!status.ok()) {
+    return status;
+  }
+  if (FLAGS_filter_false_positive_rate <= 0 ||
+      FLAGS_filter_false_positive_rate >= 1) {
+    return util::InvalidArgumentError(
+        "GetFilter: --filter_false_positive_rate must be in (0, 1).");
+  }
+
+  // Recycles the BIGNUMs of hashing each input to the curve.
+  BigNumArena arena;
+  ElementFilter filter(inputs_.size(), FLAGS_filter_false_positive_rate);
+  for (const std::string& input : inputs_) {
+    StatusOr<std::string> encrypted = filter_cipher_->Encrypt(input);
+    if (!encrypted.ok()) {
+      return encrypted.status();
+    }
+    filter.Add(ctx_, encrypted.ValueOrDie());
+  }
+  StatusOr<std::string> key_check =
+      filter_cipher_->Encrypt(kFilterKeyCheckLabel);
+  if (!key_check.ok()) {
+    return key_check.status();
+  }
+  filter_ = absl::make_unique<ServerFilter>(filter.ToProto());
+  *filter_->mutable_key_check() = key_check.ValueOrDie();
+  return *filter_;
+}
+
+StatusOr<UnbalancedServerRoundOne> Server::ReEncryptUnbalancedSet(
+    const UnbalancedClientRoundOne& client_message) {
+  util::Status status = CreateFilterCipherIfNeeded();
+  if (!status.ok()) {
+    return status;
+  }
+  // Recycles the BIGNUMs of re-encrypting the client's set.
+  BigNumArena arena;
+  UnbalancedServerRoundOne result;
+  for (const EncryptedElement& element :
+       client_message.encrypted_set().elements()) {
+    StatusOr<std::string> reenc = filter_cipher_->ReEncrypt(element.element());
+    if (!reenc.ok()) {
+      return reenc.status();
+    }
+    *result.mutable_reencrypted_set()->add_elements()->mutable_element() =
+        std::move(reenc.ValueOrDie());
+  }
+  StatusOr<std::string> key_check =
+      filter_cipher_->Encrypt(kFilterKeyCheckLabel);
+  if (!key_check.ok()) {
+    return key_check.status();
+  }
+  *result.mutable_key_check() = key_check.ValueOrDie();
   return result;
 }
 
@@ -136,6 +650,9 @@ std::string Server::GetSerializedState() const {
   if (ec_cipher_ != nullptr) {
     *state.mutable_ec_key() = ec_cipher_->GetPrivateKeyBytes();
   }
+  if (filter_cipher_ != nullptr) {
+    *state.mutable_filter_ec_key() = filter_cipher_->GetPrivateKeyBytes();
+  }
   return state.SerializeAsString();
 }
 
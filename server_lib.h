@@ -38,8 +38,11 @@ class Server {
   ~Server() = default;
 
   // The protocol begins with this party sending its encrypted set to the client
-  // party.
-  ::util::StatusOr<ServerRoundOne> EncryptSet();
+  // party. A sampling rate below 1 runs the approximate mode, where only a
+  // sample of this rate of both sets takes part, drawn with a salt derived
+  // from a share of the server and the client's share (see set_sampling.h).
+  ::util::StatusOr<ServerRoundOne> EncryptSet(
+      double sampling_rate = 1, const std::string& client_salt_share = "");
 
   // This is where the intersection-sum is computed.  The sum will be computed
   // using the Paillier homomorphism and will be returned to the client party
@@ -47,6 +50,24 @@ class Server {
   ::util::StatusOr<ServerRoundTwo> ComputeIntersection(
       const ClientRoundOne& client_message);
 
+  // Returns the Bloom filter over the server's set encrypted with its filter
+  // key, for the unbalanced mode, where the client only sends its own set and
+  // tests the server's re-encryption of it against the filter. The filter is
+  // built on the first call and kept for later calls.
+  ::util::StatusOr<ServerFilter> GetFilter();
+
+  // Re-encrypts the client's set with the filter key, in the unbalanced mode.
+  ::util::StatusOr<UnbalancedServerRoundOne> ReEncryptUnbalancedSet(
+      const UnbalancedClientRoundOne& client_message);
+
+  // Uses the given filter key instead of a new one, so that the filters kept
+  // by clients stay valid across runs of the server. Must be called before
+  // the filter key is first used.
+  ::util::Status SetFilterKey(const std::string& key_bytes);
+
+  // Returns the filter key, creating a new one if none was set.
+  ::util::StatusOr<std::string> GetFilterKey();
+
   ::private_join_and_compute::ECCommutativeCipher* GetECCipher() { return ec_cipher_.get(); }
 
   std::string GetSerializedState() const;
@@ -54,8 +75,15 @@ class Server {
  private:
   ::private_join_and_compute::Context* ctx_;  // not owned
   std::unique_ptr<ECCommutativeCipher> ec_cipher_;
+  // The long-lived key of the unbalanced mode, unlike ec_cipher_ which is new
+  // for every run of the protocol.
+  std::unique_ptr<ECCommutativeCipher> filter_cipher_;
+  std::unique_ptr<ServerFilter> filter_;
 
   std::vector<std::string> inputs_;
+
+  // Creates a new filter key unless one was set.
+  ::util::Status CreateFilterCipherIfNeeded();
 };
 
 }  // namespace private_join_and_compute
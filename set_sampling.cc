@@ -0,0 +1,69 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "set_sampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/strings/str_cat.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// The standard normal quantile of a two-sided 95% confidence interval.
+const double kConfidenceZ = 1.96;
+
+}  // namespace
+
+std::string DeriveSamplingSalt(Context* ctx, absl::string_view server_share,
+                               absl::string_view client_share) {
+  return ctx->Sha256String(absl::StrCat(server_share, client_share));
+}
+
+bool InSample(Context* ctx, absl::string_view salt, absl::string_view element,
+              double sampling_rate) {
+  if (sampling_rate >= 1) {
+    return true;
+  }
+  std::string hash = ctx->Sha256String(absl::StrCat(salt, element));
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = (value << 8) | static_cast<uint8_t>(hash[i]);
+  }
+  // Compares the hash, read as a uniform number in [0, 1), with the rate.
+  return std::ldexp(static_cast<double>(value), -64) < sampling_rate;
+}
+
+CardinalityEstimate EstimateCardinality(int64_t sampled_size,
+                                        double sampling_rate) {
+  const double k = static_cast<double>(sampled_size);
+  const double p = sampling_rate;
+  CardinalityEstimate estimate;
+  estimate.size = k / p;
+  if (sampled_size == 0) {
+    estimate.lower_bound = 0;
+    estimate.upper_bound = 3 / p;
+    return estimate;
+  }
+  // The variance of K / p is n (1 - p) / p for an intersection of size n,
+  // which is estimated by K (1 - p) / p^2.
+  const double margin = kConfidenceZ * std::sqrt(k * (1 - p)) / p;
+  estimate.lower_bound = std::max(k, estimate.size - margin);
+  estimate.upper_bound = estimate.size + margin;
+  return estimate;
+}
+
+}  // namespace private_join_and_compute
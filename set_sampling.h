@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_SET_SAMPLING_H_
+#define OPEN_SOURCE_SET_SAMPLING_H_
+
+// Contains the sampling behind the approximate mode, where both parties only
+// run the protocol on a random sample of their sets and the client estimates
+// the size of the whole intersection from the sampled one.
+//
+// Whether an element is sampled only depends on the element and on a salt
+// derived from a random share of each party, which the client sends with its
+// request and the server with its encrypted set. Both parties thus sample the
+// same common elements. Each element of the intersection is then sampled
+// independently with the sampling rate p, and the sampled intersection size K
+// follows a binomial distribution with mean p times the intersection size.
+// The EC work and the communication shrink by a factor of p.
+//
+// Each party sends only its sample, so the server learns the size of the
+// client's sample, which is about p times the size of the client's set, and
+// the client that of the server's.
+//
+// The server draws its share after receiving the client's, so the client's
+// share does not stop a dishonest server from trying many shares until the
+// sample includes or excludes elements of its choice. The size of the client's
+// sample then tells whether the client holds those elements. The approximate
+// mode is thus only meant for servers trusted to follow the protocol.
+
+#include <cstdint>
+#include <string>
+
+#include "crypto/context.h"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+// The length of the salt share drawn by each party, in bytes.
+const int kSamplingSaltBytes = 16;
+
+// Returns the salt of a run from the server's and the client's salt shares,
+// which must both be kSamplingSaltBytes long.
+std::string DeriveSamplingSalt(Context* ctx, absl::string_view server_share,
+                               absl::string_view client_share);
+
+// Returns whether the element is in the sample drawn with the salt, which
+// holds each element with probability sampling_rate.
+bool InSample(Context* ctx, absl::string_view salt, absl::string_view element,
+              double sampling_rate);
+
+// An estimate of the size of an intersection, with a confidence interval.
+struct CardinalityEstimate {
+  double size;
+  double lower_bound;
+  double upper_bound;
+};
+
+// Returns the estimate K / p of the size of the intersection whose sample of
+// rate p has K elements, with an approximate 95% confidence interval from the
+// normal approximation of the binomial distribution of K. The lower bound is
+// at least K. If K is 0, the upper bound is 3 / p, as from the rule of three.
+CardinalityEstimate EstimateCardinality(int64_t sampled_size,
+                                        double sampling_rate);
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_SET_SAMPLING_H_
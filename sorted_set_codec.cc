@@ -0,0 +1,260 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sorted_set_codec.h"
+
+#include <algorithm>
+
+#include "absl/memory/memory.h"
+
+namespace private_join_and_compute {
+namespace {
+
+// The longest quotient written in unary. Larger quotients, such as the jump
+// between the two tags of compressed points, are written in full instead.
+const uint64_t kRiceEscape = 32;
+
+// The largest prefix, in bytes.
+const size_t kMaxPrefixSize = 8;
+
+// The largest element a decoder accepts, in bytes.
+const uint64_t kMaxElementSize = 1 << 16;
+
+// Returns the first prefix_size bytes of the element as a big-endian integer.
+uint64_t Prefix(absl::string_view element, size_t prefix_size) {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < prefix_size; i++) {
+    prefix = (prefix << 8) | static_cast<uint8_t>(element[i]);
+  }
+  return prefix;
+}
+
+void WriteVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+// Reads a varint at *position and advances it, or returns false if the input
+// ends first.
+bool ReadVarint(absl::string_view in, size_t* position, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *position < in.size(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(in[(*position)++]);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Appends bits to a string, most significant bit first.
+class BitWriter {
+ public:
+  explicit BitWriter(std::string* out) : out_(out) {}
+
+  // Writes the count <= 64 low bits of the value.
+  void WriteBits(uint64_t value, int count) {
+    if (count > 32) {
+      WriteBits(value >> 32, count - 32);
+      count = 32;
+    }
+    buffer_ = (buffer_ << count) | (value & ((uint64_t{1} << count) - 1));
+    buffered_ += count;
+    while (buffered_ >= 8) {
+      buffered_ -= 8;
+      out_->push_back(static_cast<char>(buffer_ >> buffered_));
+    }
+  }
+
+  // Writes the bits still buffered, padded with zeros to a whole byte.
+  void Flush() {
+    if (buffered_ > 0) {
+      out_->push_back(static_cast<char>(buffer_ << (8 - buffered_)));
+      buffered_ = 0;
+    }
+  }
+
+ private:
+  std::string* out_;
+  uint64_t buffer_ = 0;
+  int buffered_ = 0;
+};
+
+}  // namespace
+
+util::StatusOr<std::string> EncodeSortedSet(
+    const std::vector<std::string>& elements) {
+  const size_t element_size = elements.empty() ? 0 : elements[0].size();
+  const size_t prefix_size = std::min(element_size, kMaxPrefixSize);
+  std::vector<uint64_t> deltas;
+  deltas.reserve(elements.size());
+  long double delta_sum = 0;
+  uint64_t previous_prefix = 0;
+  for (size_t i = 0; i < elements.size(); i++) {
+    if (elements[i].size() != element_size) {
+      return util::InvalidArgumentError(
+          "EncodeSortedSet: The elements do not all have the same size.");
+    }
+    if (i > 0 && elements[i] < elements[i - 1]) {
+      return util::InvalidArgumentError(
+          "EncodeSortedSet: The elements are not sorted.");
+    }
+    uint64_t prefix = Prefix(elements[i], prefix_size);
+    deltas.push_back(prefix - previous_prefix);
+    delta_sum += deltas.back();
+    previous_prefix = prefix;
+  }
+
+  // The Rice parameter close to the log of the mean difference minimizes the
+  // expected code length for geometrically distributed differences.
+  int rice_parameter = 0;
+  if (!deltas.empty()) {
+    long double mean = delta_sum / deltas.size();
+    while (rice_parameter < 63 && mean >= 2) {
+      mean /= 2;
+      rice_parameter++;
+    }
+  }
+
+  std::string encoded;
+  WriteVarint(elements.size(), &encoded);
+  WriteVarint(element_size, &encoded);
+  encoded.push_back(static_cast<char>(rice_parameter));
+  encoded.reserve(encoded.size() +
+                  elements.size() * (element_size - prefix_size) +
+                  elements.size() * (rice_parameter + 2) / 8 + 1);
+  for (const std::string& element : elements) {
+    encoded.append(element, prefix_size, std::string::npos);
+  }
+  BitWriter writer(&encoded);
+  for (uint64_t delta : deltas) {
+    uint64_t quotient = delta >> rice_parameter;
+    if (quotient >= kRiceEscape) {
+      writer.WriteBits(~uint64_t{0}, kRiceEscape);
+      writer.WriteBits(delta, 64);
+      continue;
+    }
+    writer.WriteBits(~uint64_t{0}, quotient);
+    writer.WriteBits(0, 1);
+    writer.WriteBits(delta, rice_parameter);
+  }
+  writer.Flush();
+  return std::move(encoded);
+}
+
+SortedSetDecoder::SortedSetDecoder(absl::string_view suffixes,
+                                   absl::string_view bits, size_t size,
+                                   size_t element_size, int rice_parameter)
+    : suffixes_(suffixes),
+      bits_(bits),
+      size_(size),
+      element_size_(element_size),
+      prefix_size_(std::min(element_size, kMaxPrefixSize)),
+      rice_parameter_(rice_parameter),
+      element_(element_size, '\0') {}
+
+util::StatusOr<std::unique_ptr<SortedSetDecoder>> SortedSetDecoder::Create(
+    absl::string_view encoded) {
+  size_t position = 0;
+  uint64_t size, element_size;
+  if (!ReadVarint(encoded, &position, &size) ||
+      !ReadVarint(encoded, &position, &element_size) ||
+      position >= encoded.size()) {
+    return util::InvalidArgumentError("SortedSetDecoder: Truncated header.");
+  }
+  int rice_parameter = static_cast<uint8_t>(encoded[position++]);
+  const uint64_t suffix_size =
+      element_size - std::min<uint64_t>(element_size, kMaxPrefixSize);
+  if (rice_parameter > 63 || element_size > kMaxElementSize ||
+      (suffix_size > 0 && size > (encoded.size() - position) / suffix_size)) {
+    return util::InvalidArgumentError("SortedSetDecoder: Corrupt header.");
+  }
+  // Each difference takes at least 1 + k bits, so the size is also bounded
+  // when the elements have no suffix.
+  const uint64_t num_bits =
+      (encoded.size() - position - size * suffix_size) * uint64_t{8};
+  if (size > num_bits / (1 + rice_parameter)) {
+    return util::InvalidArgumentError("SortedSetDecoder: Corrupt header.");
+  }
+  absl::string_view suffixes = encoded.substr(position, size * suffix_size);
+  absl::string_view bits = encoded.substr(position + suffixes.size());
+  return absl::WrapUnique(new SortedSetDecoder(
+      suffixes, bits, size, element_size, rice_parameter));
+}
+
+bool SortedSetDecoder::ReadBits(int count, uint64_t* value) {
+  if (bit_position_ + count > bits_.size() * 8) {
+    return false;
+  }
+  *value = 0;
+  while (count > 0) {
+    size_t byte_bits_left = 8 - bit_position_ % 8;
+    int take = static_cast<int>(
+        std::min<size_t>(byte_bits_left, static_cast<size_t>(count)));
+    uint8_t byte = static_cast<uint8_t>(bits_[bit_position_ / 8]);
+    uint64_t chunk = (byte >> (byte_bits_left - take)) & ((1u << take) - 1);
+    *value = (*value << take) | chunk;
+    bit_position_ += take;
+    count -= take;
+  }
+  return true;
+}
+
+bool SortedSetDecoder::Next() {
+  if (!status_.ok() || next_ == size_) {
+    return false;
+  }
+  uint64_t quotient = 0;
+  uint64_t bit;
+  do {
+    if (!ReadBits(1, &bit)) {
+      status_ = util::InvalidArgumentError(
+          "SortedSetDecoder: Truncated differences.");
+      return false;
+    }
+    quotient += bit;
+  } while (bit == 1 && quotient < kRiceEscape);
+
+  uint64_t delta;
+  bool read;
+  if (quotient == kRiceEscape) {
+    read = ReadBits(64, &delta);
+  } else {
+    uint64_t remainder = 0;
+    read = ReadBits(rice_parameter_, &remainder);
+    delta = (quotient << rice_parameter_) | remainder;
+  }
+  if (!read) {
+    status_ = util::InvalidArgumentError(
+        "SortedSetDecoder: Truncated differences.");
+    return false;
+  }
+  prefix_ += delta;
+
+  for (size_t i = 0; i < prefix_size_; i++) {
+    element_[i] = static_cast<char>(prefix_ >> (8 * (prefix_size_ - 1 - i)));
+  }
+  const size_t suffix_size = element_size_ - prefix_size_;
+  std::copy_n(suffixes_.data() + next_ * suffix_size, suffix_size,
+              &element_[prefix_size_]);
+  next_++;
+  return true;
+}
+
+}  // namespace private_join_and_compute
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_SORTED_SET_CODEC_H_
+#define OPEN_SOURCE_SORTED_SET_CODEC_H_
+
+// Contains a lossless compact encoding of sorted sets of equally long,
+// uniformly distributed elements, such as doubly encrypted points or their
+// fingerprints.
+//
+// Neighbours in a sorted set of n such elements share about log2(n) leading
+// bits. The encoding splits each element into a prefix of up to 8 bytes and a
+// suffix. The differences between consecutive prefixes are Rice coded, so the
+// shared bits cost almost nothing, and the suffixes are stored back to back
+// without any framing. The elements can be decoded one at a time.
+//
+// The encoding is:
+//   - the number of elements n and their size w, as varints;
+//   - the Rice parameter k, as one byte;
+//   - the n suffixes of w - min(w, 8) bytes each;
+//   - for each element, the difference of its prefix with the previous one,
+//     read as big-endian integers: the quotient by 2^k in unary (ones ended
+//     by a zero) and the k low bits, most significant bit first. A quotient
+//     of 32 or more is written as 32 ones followed by the whole difference in
+//     64 bits.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/status.inc"
+#include "absl/strings/string_view.h"
+
+namespace private_join_and_compute {
+
+// Returns the encoding of the elements.
+//
+// Fails with INVALID_ARGUMENT if the elements are not sorted or do not all
+// have the same size.
+util::StatusOr<std::string> EncodeSortedSet(
+    const std::vector<std::string>& elements);
+
+// Decodes the elements of an encoded sorted set one at a time.
+class SortedSetDecoder {
+ public:
+  // Returns a decoder positioned before the first element.
+  //
+  // Fails with INVALID_ARGUMENT if the header is corrupt.
+  static util::StatusOr<std::unique_ptr<SortedSetDecoder>> Create(
+      absl::string_view encoded);
+
+  SortedSetDecoder(const SortedSetDecoder&) = delete;
+  SortedSetDecoder& operator=(const SortedSetDecoder&) = delete;
+
+  // Moves to the next element, or returns false after the last element or if
+  // the encoding is corrupt, in which case status() tells.
+  bool Next();
+
+  // Returns the current element, which is valid until the next call to Next.
+  absl::string_view element() const { return element_; }
+
+  // Returns the number of elements.
+  size_t size() const { return size_; }
+
+  // Returns the size of each element.
+  size_t element_size() const { return element_size_; }
+
+  // Returns OK unless the encoding turned out to be corrupt.
+  util::Status status() const { return status_; }
+
+ private:
+  SortedSetDecoder(absl::string_view suffixes, absl::string_view bits,
+                   size_t size, size_t element_size, int rice_parameter);
+
+  // Reads count <= 64 bits into *value, or returns false at the end.
+  bool ReadBits(int count, uint64_t* value);
+
+  absl::string_view suffixes_;
+  absl::string_view bits_;
+  size_t size_;
+  size_t element_size_;
+  size_t prefix_size_;
+  int rice_parameter_;
+
+  size_t next_ = 0;
+  size_t bit_position_ = 0;
+  uint64_t prefix_ = 0;
+  std::string element_;
+  util::Status status_;
+};
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_SORTED_SET_CODEC_H_
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unbalanced_client_lib.h"
+
+#include "element_filter.h"
+
+namespace private_join_and_compute {
+
+using ::util::StatusOr;
+
+UnbalancedClient::UnbalancedClient(
+    Context* ctx, std::vector<std::string> elements,
+    std::vector<std::vector<int64_t>> value_columns)
+    : ctx_(ctx),
+      elements_(std::move(elements)),
+      value_columns_(std::move(value_columns)),
+      ec_cipher_(std::move(
+          ECCommutativeCipher::CreateWithNewKey(NID_secp224r1).ValueOrDie())) {
+  for (const std::vector<int64_t>& column : value_columns_) {
+    CHECK_EQ(column.size(), elements_.size())
+        << "Each column must have one value per element.";
+    for (int64_t value : column) {
+      CHECK_GE(value, 0) << "Values must be nonnegative.";
+    }
+  }
+}
+
+StatusOr<UnbalancedClientRoundOne> UnbalancedClient::EncryptSet() {
+  // Recycles the BIGNUMs of hashing each element to the curve.
+  BigNumArena arena;
+  UnbalancedClientRoundOne result;
+  for (const std::string& element : elements_) {
+    StatusOr<std::string> encrypted = ec_cipher_->Encrypt(element);
+    if (!encrypted.ok()) {
+      return encrypted.status();
+    }
+    *result.mutable_encrypted_set()->add_elements()->mutable_element() =
+        std::move(encrypted.ValueOrDie());
+  }
+  return result;
+}
+
+StatusOr<std::pair<int64_t, std::vector<BigNum>>>
+UnbalancedClient::ComputeIntersectionSums(
+    const ServerFilter& filter,
+    const UnbalancedServerRoundOne& server_message) {
+  if (filter.key_check() != server_message.key_check()) {
+    return util::InvalidArgumentError(
+        "ComputeIntersectionSums: The filter does not match the server's "
+        "filter key.");
+  }
+  const auto& reencrypted_set = server_message.reencrypted_set().elements();
+  if (reencrypted_set.size() != static_cast<int>(elements_.size())) {
+    return util::InvalidArgumentError(
+        "ComputeIntersectionSums: The server re-encrypted another number of "
+        "elements than the client sent.");
+  }
+  StatusOr<ElementFilter> element_filter = ElementFilter::FromProto(filter);
+  if (!element_filter.ok()) {
+    return element_filter.status();
+  }
+
+  // Removing the client's encryption leaves each element encrypted with the
+  // filter key only, as the server's elements are in the filter.
+  BigNumArena arena;
+  int64_t intersection_size = 0;
+  std::vector<BigNum> sums(value_columns_.size(), ctx_->Zero());
+  for (int i = 0; i < reencrypted_set.size(); i++) {
+    StatusOr<std::string> decrypted =
+        ec_cipher_->Decrypt(reencrypted_set[i].element());
+    if (!decrypted.ok()) {
+      return decrypted.status();
+    }
+    if (!element_filter.ValueOrDie().MayContain(ctx_,
+                                                decrypted.ValueOrDie())) {
+      continue;
+    }
+    intersection_size++;
+    for (size_t k = 0; k < value_columns_.size(); k++) {
+      sums[k] = sums[k] + ctx_->CreateBigNum(value_columns_[k][i]);
+    }
+  }
+  return std::make_pair(intersection_size, std::move(sums));
+}
+
+}  // namespace private_join_and_compute
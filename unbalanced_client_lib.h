@@ -0,0 +1,75 @@
+/*
+ * Copyright 2019 Google Inc.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_SOURCE_UNBALANCED_CLIENT_LIB_H_
+#define OPEN_SOURCE_UNBALANCED_CLIENT_LIB_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "crypto/context.h"
+#include "match.pb.h"
+#include "util/status.inc"
+#include "crypto/ec_commutative_cipher.h"
+
+namespace private_join_and_compute {
+
+// The "client" part of the unbalanced mode, for small client sets against very
+// large server sets.
+//
+// The server builds a Bloom filter over its set encrypted with a long-lived
+// filter key once, and the client fetches it once and keeps it. In each
+// session, the client sends its set encrypted with a new key of its own, the
+// server re-encrypts it with the filter key, and the client removes its own
+// encryption and tests the result against the filter. The work and bandwidth
+// of a session thus grow with the client's set only.
+//
+// Unlike the Client, this party learns which of its elements are in the
+// intersection, and sums their associated values itself, while the server
+// learns nothing but the size of the client's set. An element that is not in
+// the server's set is counted with the false positive rate of the filter.
+class UnbalancedClient {
+ public:
+  // value_columns[k][i] is the k-th value associated with elements[i].
+  // The values must be nonnegative.
+  UnbalancedClient(Context* ctx, std::vector<std::string> elements,
+                   std::vector<std::vector<int64_t>> value_columns);
+
+  // Returns the client's set encrypted with the client's key.
+  ::util::StatusOr<UnbalancedClientRoundOne> EncryptSet();
+
+  // Tests the server's re-encryption of the client's set against the server's
+  // filter, and returns the intersection size and one intersection sum per
+  // column of associated values.
+  //
+  // Fails with INVALID_ARGUMENT if the filter was built with another key than
+  // the re-encryption, e.g. if a kept filter is out of date.
+  ::util::StatusOr<std::pair<int64_t, std::vector<BigNum>>>
+  ComputeIntersectionSums(const ServerFilter& filter,
+                          const UnbalancedServerRoundOne& server_message);
+
+ private:
+  Context* ctx_;  // not owned
+  std::vector<std::string> elements_;
+  std::vector<std::vector<int64_t>> value_columns_;
+
+  std::unique_ptr<ECCommutativeCipher> ec_cipher_;
+};
+
+}  // namespace private_join_and_compute
+
+#endif  // OPEN_SOURCE_UNBALANCED_CLIENT_LIB_H_
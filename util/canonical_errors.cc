@@ -29,6 +29,10 @@ Status InvalidArgumentError(const std::string& message) {
   return Status(private_join_and_compute::StatusCode::kInvalidArgument, message);
 }
 
+Status NotFoundError(const std::string& message) {
+  return Status(private_join_and_compute::StatusCode::kNotFound, message);
+}
+
 bool IsInternal(const Status& status) {
   return status.code() == private_join_and_compute::StatusCode::kInternal;
 }
@@ -37,4 +41,8 @@ bool IsInvalidArgument(const Status& status) {
   return status.code() == private_join_and_compute::StatusCode::kInvalidArgument;
 }
 
+bool IsNotFound(const Status& status) {
+  return status.code() == private_join_and_compute::StatusCode::kNotFound;
+}
+
 }  // namespace util
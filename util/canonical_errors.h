@@ -24,9 +24,11 @@ namespace util {
 
 Status InternalError(const std::string& message);
 Status InvalidArgumentError(const std::string& message);
+Status NotFoundError(const std::string& message);
 
 bool IsInternal(const Status& status);
 bool IsInvalidArgument(const Status& status);
+bool IsNotFound(const Status& status);
 
 }  // namespace util
 